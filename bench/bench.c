@@ -0,0 +1,356 @@
+// Front-end and hashtable benchmarks over synthetic corpora.
+//
+//   bench [--size BYTES] [--depth N] [--iterations N] [--keys N] [--shape NAME]...
+//   bench --shape NAME [--size BYTES] [--depth N] --write FILE
+//
+// Results are written to stdout as one JSON object; progress and errors
+// go to stderr. Every timing is the fastest of --iterations runs. With
+// --write the corpus is saved instead, as input for the interpreter.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "corpus.h"
+#include "scanner/scanner.h"
+#include "parser/parser.h"
+#include "memory/arena.h"
+#include "intern/intern.h"
+#include "hash/hashtable.h"
+#include "chunk/chunk.h"
+#include "compiler/compiler.h"
+#include "optimizer/optimizer.h"
+
+typedef struct{
+    size_t size;
+    int depth;
+    int iterations;
+    size_t keys;
+    bool shapes[CORPUS_SHAPE_COUNT];
+    const char* output;
+} BenchConfig;
+
+static double now(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// counts with an explicit stack; operator chains are one long left spine
+static size_t countNodes(Expr* root){
+    size_t capacity = 64;
+    size_t count = 0;
+    size_t top = 0;
+    Expr** stack = (Expr**)malloc(sizeof(Expr*) * capacity);
+    if(!stack) return 0;
+    if(root) stack[top++] = root;
+    while(top > 0){
+        Expr* expr = stack[--top];
+        count++;
+        if(top + 2 > capacity){
+            capacity *= 2;
+            Expr** grown = (Expr**)realloc(stack, sizeof(Expr*) * capacity);
+            if(!grown){
+                free(stack);
+                return 0;
+            }
+            stack = grown;
+        }
+        switch(expr->type){
+            case EXPR_BINARY:
+                stack[top++] = expr->expression.binary.left;
+                stack[top++] = expr->expression.binary.right;
+                break;
+            case EXPR_GROUPING:
+                stack[top++] = expr->expression.grouping.expression;
+                break;
+            case EXPR_UNARY:
+                stack[top++] = expr->expression.unary.right;
+                break;
+            case EXPR_LITERAL:
+                break;
+        }
+    }
+    free(stack);
+    return count;
+}
+
+static void benchCorpus(BenchConfig* config, CorpusShape shape, bool first){
+    Corpus corpus;
+    if(!generateCorpus(shape, config->size, config->depth, &corpus)) return;
+    fprintf(stderr, "%s: %zu bytes\n", corpusShapeName(shape), corpus.length);
+
+    double scanBest = 1e30;
+    size_t tokenCount = 0;
+    for(int i = 0; i < config->iterations; i++){
+        hadError = false;
+        double start = now();
+        initScanner(corpus.source, corpus.length);
+        TokenList tokens;
+        bool scanned = scanTokens(&tokens);
+        double elapsed = now() - start;
+        if(!scanned){
+            freeCorpus(&corpus);
+            return;
+        }
+        tokenCount = tokens.count;
+        freeTokenList(&tokens);
+        if(elapsed < scanBest) scanBest = elapsed;
+    }
+
+    printf("%s\n    {\"shape\": \"%s\", \"bytes\": %zu, \"tokens\": %zu,\n", first ? "" : ",",
+           corpusShapeName(shape), corpus.length, tokenCount);
+    printf("     \"scan\": {\"seconds\": %.9f, \"mb_per_s\": %.3f, \"tokens_per_s\": %.0f},\n",
+           scanBest, corpus.length / scanBest / 1e6, tokenCount / scanBest);
+
+    bool parsed = false;
+    if(corpusParses(shape)) initScanner(corpus.source, corpus.length);
+    // a list that could not be scanned whole reports as unparsed
+    TokenList tokens;
+    if(corpusParses(shape) && scanTokens(&tokens)){
+        Arena arena;
+        initArena(&arena);
+        double parseBest = 1e30;
+        double compileBest = 1e30;
+        double optimizeBest = 1e30;
+        double teardownBest = 1e30;
+        size_t nodes = 0;
+        parsed = true;
+        // folding the strings corpus builds every prefix of one long
+        // concatenation, which is quadratic in memory
+        bool optimizes = shape != CORPUS_STRINGS;
+        for(int i = 0; i < config->iterations && parsed; i++){
+            hadParseError = false;
+            double start = now();
+            initParserFromList(&tokens, &arena);
+            Expr* expr = parse();
+            double elapsed = now() - start;
+            if(hadParseError || !expr){
+                fprintf(stderr, "%s: parse failed\n", corpusShapeName(shape));
+                parsed = false;
+            }
+            else{
+                nodes = countNodes(expr);
+                // compiled as parsed, then optimized, which rewrites the tree
+                Chunk chunk;
+                initChunk(&chunk);
+                start = now();
+                compile(expr, &chunk, stderr);
+                double compiled = now() - start;
+                freeChunk(&chunk);
+                if(compiled < compileBest) compileBest = compiled;
+                if(optimizes){
+                    start = now();
+                    optimize(expr);
+                    double optimized = now() - start;
+                    if(optimized < optimizeBest) optimizeBest = optimized;
+                }
+            }
+            // nodes are arena-allocated, so tearing the tree down is a reset
+            start = now();
+            resetArena(&arena);
+            double teardown = now() - start;
+            if(elapsed < parseBest) parseBest = elapsed;
+            if(teardown < teardownBest) teardownBest = teardown;
+        }
+        freeArena(&arena);
+        freeTokenList(&tokens);
+        if(parsed){
+            printf("     \"parse\": {\"nodes\": %zu, \"seconds\": %.9f, \"nodes_per_s\": %.0f},\n",
+                   nodes, parseBest, nodes / parseBest);
+            printf("     \"compile\": {\"seconds\": %.9f, \"ns_per_node\": %.3f},\n",
+                   compileBest, nodes ? compileBest * 1e9 / nodes : 0.0);
+            if(optimizes){
+                printf("     \"optimize\": {\"seconds\": %.9f, \"ns_per_node\": %.3f},\n",
+                       optimizeBest, nodes ? optimizeBest * 1e9 / nodes : 0.0);
+            }
+            else{
+                printf("     \"optimize\": null,\n");
+            }
+            printf("     \"teardown\": {\"seconds\": %.9f, \"ns_per_node\": %.3f}}",
+                   teardownBest, nodes ? teardownBest * 1e9 / nodes : 0.0);
+        }
+    }
+    if(!parsed){
+        printf("     \"parse\": null, \"compile\": null, \"optimize\": null, \"teardown\": null}");
+    }
+    freeCorpus(&corpus);
+}
+
+static void benchTable(BenchConfig* config){
+    size_t keyCount = config->keys;
+    // NUL-separated keys in one block; the tail half are never inserted
+    char* block = (char*)malloc(keyCount * 2 * 24);
+    size_t* offsets = (size_t*)malloc(sizeof(size_t) * keyCount * 2);
+    size_t* order = (size_t*)malloc(sizeof(size_t) * keyCount);
+    if(!block || !offsets || !order){
+        fprintf(stderr, "Failed to allocate memory for table benchmark\n");
+        free(block);
+        free(offsets);
+        free(order);
+        printf("null");
+        return;
+    }
+    size_t used = 0;
+    for(size_t i = 0; i < keyCount * 2; i++){
+        offsets[i] = used;
+        used += (size_t)sprintf(block + used, "%s%zu", i % 3 == 0 ? "a_rather_long_key_" : "k", i) + 1;
+    }
+    // lookups in shuffled order so consecutive probes do not share cache lines
+    uint64_t seed = 0x9e3779b97f4a7c15ULL;
+    for(size_t i = 0; i < keyCount; i++) order[i] = i;
+    for(size_t i = keyCount; i > 1; i--){
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        size_t j = (size_t)(seed % i);
+        size_t swap = order[i-1];
+        order[i-1] = order[j];
+        order[j] = swap;
+    }
+
+    double insertBest = 1e30, lookupBest = 1e30, missBest = 1e30, deleteBest = 1e30;
+    for(int iteration = 0; iteration < config->iterations; iteration++){
+        Table table;
+        initTable(&table);
+        double start = now();
+        for(size_t i = 0; i < keyCount; i++){
+            const char* key = block + offsets[i];
+            makeEntry(&table, key, strlen(key), (void*)(uintptr_t)(i + 1));
+        }
+        double insert = now() - start;
+
+        size_t found = 0;
+        start = now();
+        for(size_t i = 0; i < keyCount; i++){
+            const char* key = block + offsets[order[i]];
+            found += getEntry(&table, key, strlen(key)) != NULL;
+        }
+        double lookup = now() - start;
+
+        start = now();
+        for(size_t i = 0; i < keyCount; i++){
+            const char* key = block + offsets[keyCount + order[i]];
+            found += getEntry(&table, key, strlen(key)) != NULL;
+        }
+        double miss = now() - start;
+
+        start = now();
+        for(size_t i = 0; i < keyCount; i++){
+            const char* key = block + offsets[order[i]];
+            found += deleteEntry(&table, key, strlen(key));
+        }
+        double removal = now() - start;
+        freeTable(&table);
+
+        if(found != keyCount * 2) fprintf(stderr, "table: expected %zu hits, got %zu\n", keyCount * 2, found);
+        if(insert < insertBest) insertBest = insert;
+        if(lookup < lookupBest) lookupBest = lookup;
+        if(miss < missBest) missBest = miss;
+        if(removal < deleteBest) deleteBest = removal;
+    }
+    printf("{\"keys\": %zu, \"insert_ns\": %.2f, \"lookup_ns\": %.2f, \"miss_ns\": %.2f, \"delete_ns\": %.2f}",
+           keyCount, insertBest * 1e9 / keyCount, lookupBest * 1e9 / keyCount,
+           missBest * 1e9 / keyCount, deleteBest * 1e9 / keyCount);
+    free(block);
+    free(offsets);
+    free(order);
+}
+
+static bool parseSize(const char* text, size_t* out){
+    char* end;
+    unsigned long long value = strtoull(text, &end, 10);
+    if(end == text) return false;
+    if(*end == 'k' || *end == 'K') value <<= 10, end++;
+    else if(*end == 'm' || *end == 'M') value <<= 20, end++;
+    if(*end != '\0' || value == 0) return false;
+    *out = (size_t)value;
+    return true;
+}
+
+static void usage(){
+    fprintf(stderr, "Usage: bench [--size BYTES] [--depth N] [--iterations N] [--keys N] [--shape NAME]...\n");
+    fprintf(stderr, "       bench --shape NAME [--size BYTES] [--depth N] --write FILE\n");
+    fprintf(stderr, "Shapes:");
+    for(int i = 0; i < CORPUS_SHAPE_COUNT; i++) fprintf(stderr, " %s", corpusShapeName((CorpusShape)i));
+    fprintf(stderr, "\n");
+}
+
+// saves the one selected shape's corpus to config->output
+static bool writeCorpus(BenchConfig* config){
+    int selected = -1;
+    for(int i = 0; i < CORPUS_SHAPE_COUNT; i++){
+        if(!config->shapes[i]) continue;
+        if(selected >= 0){
+            fprintf(stderr, "--write takes exactly one --shape\n");
+            return false;
+        }
+        selected = i;
+    }
+    if(selected < 0){
+        fprintf(stderr, "--write takes exactly one --shape\n");
+        return false;
+    }
+    Corpus corpus;
+    if(!generateCorpus((CorpusShape)selected, config->size, config->depth, &corpus)) return false;
+    FILE* file = fopen(config->output, "wb");
+    bool written = file && fwrite(corpus.source, 1, corpus.length, file) == corpus.length;
+    if(file && fclose(file) != 0) written = false;
+    if(!written) fprintf(stderr, "Could not write \"%s\"\n", config->output);
+    freeCorpus(&corpus);
+    return written;
+}
+
+int main(int argc, char* argv[]){
+    BenchConfig config = {1 << 20, 32, 5, 100000, {false}, NULL};
+    bool anyShape = false;
+    for(int i = 1; i < argc; i++){
+        const char* value = i + 1 < argc ? argv[i+1] : NULL;
+        size_t number;
+        if(value && strcmp(argv[i], "--write") == 0){
+            config.output = value;
+            i++;
+            continue;
+        }
+        if(!value || !parseSize(value, &number)){
+            CorpusShape shape;
+            if(value && strcmp(argv[i], "--shape") == 0 && corpusShapeFromName(value, &shape)){
+                config.shapes[shape] = true;
+                anyShape = true;
+                i++;
+                continue;
+            }
+            usage();
+            return 64;
+        }
+        if(strcmp(argv[i], "--size") == 0) config.size = number;
+        else if(strcmp(argv[i], "--depth") == 0) config.depth = (int)number;
+        else if(strcmp(argv[i], "--iterations") == 0) config.iterations = (int)number;
+        else if(strcmp(argv[i], "--keys") == 0) config.keys = number;
+        else{
+            usage();
+            return 64;
+        }
+        i++;
+    }
+    if(config.output) return writeCorpus(&config) ? 0 : 1;
+    if(!anyShape){
+        for(int i = 0; i < CORPUS_SHAPE_COUNT; i++) config.shapes[i] = true;
+    }
+
+    initInternTable();
+    printf("{\"config\": {\"size\": %zu, \"depth\": %d, \"iterations\": %d, \"keys\": %zu},\n",
+           config.size, config.depth, config.iterations, config.keys);
+    printf(" \"corpora\": [");
+    bool first = true;
+    for(int i = 0; i < CORPUS_SHAPE_COUNT; i++){
+        if(!config.shapes[i]) continue;
+        benchCorpus(&config, (CorpusShape)i, first);
+        first = false;
+    }
+    printf("\n ],\n \"table\": ");
+    benchTable(&config);
+    printf("\n}\n");
+    freeInternTable();
+    return 0;
+}
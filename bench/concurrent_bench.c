@@ -0,0 +1,194 @@
+// Stress test and thread-scaling benchmark for ConcurrentTable.
+//
+//   concurrent_bench [--stress] [max-threads] [keys]
+//
+// The stress phase has every thread insert, overwrite, read and delete
+// its own keys while also reading a shared key set, then checks the
+// table's final contents. The scaling phase times a 90% lookup / 10%
+// update mix from 1 thread up to max-threads. --stress runs only the
+// stress phase, as ctest does.
+#include "hash/concurrent.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#define STRESS_ROUNDS 4
+#define SCALING_OPS 1000000
+
+typedef struct{
+    ConcurrentTable* table;
+    int id;
+    size_t keys;
+    size_t sharedKeys;
+    size_t ops;
+    size_t failures;
+    uint64_t seed;
+} Worker;
+
+static size_t formatKey(char* buffer, size_t size, int owner, size_t index){
+    return (size_t)snprintf(buffer, size, "key-%d-%zu", owner, index);
+}
+
+// values are small integers smuggled through the void* slot; 0 means missing
+static void* encode(size_t value){
+    return (void*)(uintptr_t)(value + 1);
+}
+
+static uint64_t nextRandom(uint64_t* state){
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static double now(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void* stressWorker(void* arg){
+    Worker* worker = (Worker*)arg;
+    char key[64];
+    for(int round = 0; round < STRESS_ROUNDS; round++){
+        for(size_t i = 0; i < worker->keys; i++){
+            size_t length = formatKey(key, sizeof(key), worker->id, i);
+            makeConcurrentEntry(worker->table, key, length, encode(i));
+        }
+        for(size_t i = 0; i < worker->keys; i++){
+            size_t length = formatKey(key, sizeof(key), worker->id, i);
+            makeConcurrentEntry(worker->table, key, length, encode(i * 2));
+            if(getConcurrentEntry(worker->table, key, length) != encode(i * 2)) worker->failures++;
+            // shared keys are never written after setup, so must always be found
+            size_t shared = (size_t)(nextRandom(&worker->seed) % worker->sharedKeys);
+            length = formatKey(key, sizeof(key), -1, shared);
+            if(getConcurrentEntry(worker->table, key, length) != encode(shared)) worker->failures++;
+        }
+        // the last round leaves the odd keys behind for the final check
+        for(size_t i = 0; i < worker->keys; i++){
+            if(round == STRESS_ROUNDS - 1 && i % 2 == 1) continue;
+            size_t length = formatKey(key, sizeof(key), worker->id, i);
+            if(!deleteConcurrentEntry(worker->table, key, length)) worker->failures++;
+            if(getConcurrentEntry(worker->table, key, length) != NULL) worker->failures++;
+        }
+    }
+    return NULL;
+}
+
+static void* scalingWorker(void* arg){
+    Worker* worker = (Worker*)arg;
+    char key[64];
+    for(size_t i = 0; i < worker->ops; i++){
+        uint64_t r = nextRandom(&worker->seed);
+        size_t index = (size_t)(r % worker->sharedKeys);
+        size_t length = formatKey(key, sizeof(key), -1, index);
+        if(r % 10 == 0){
+            makeConcurrentEntry(worker->table, key, length, encode(index));
+        }
+        else if(getConcurrentEntry(worker->table, key, length) == NULL){
+            worker->failures++;
+        }
+    }
+    return NULL;
+}
+
+static bool runWorkers(int threads, Worker* workers, void* (*body)(void*)){
+    pthread_t* ids = (pthread_t*)malloc(sizeof(pthread_t) * (size_t)threads);
+    if(!ids){
+        fprintf(stderr, "Failed to allocate memory for threads\n");
+        return false;
+    }
+    for(int i = 0; i < threads; i++){
+        pthread_create(&ids[i], NULL, body, &workers[i]);
+    }
+    for(int i = 0; i < threads; i++){
+        pthread_join(ids[i], NULL);
+    }
+    free(ids);
+    return true;
+}
+
+static void fillShared(ConcurrentTable* table, size_t sharedKeys){
+    char key[64];
+    for(size_t i = 0; i < sharedKeys; i++){
+        size_t length = formatKey(key, sizeof(key), -1, i);
+        makeConcurrentEntry(table, key, length, encode(i));
+    }
+}
+
+static bool stress(int threads, size_t keys){
+    ConcurrentTable table;
+    initConcurrentTable(&table);
+    size_t sharedKeys = keys;
+    fillShared(&table, sharedKeys);
+
+    Worker workers[threads];
+    for(int i = 0; i < threads; i++){
+        workers[i] = (Worker){&table, i, keys, sharedKeys, 0, 0, 0x9e3779b97f4a7c15ULL * (uint64_t)(i + 1)};
+    }
+    double start = now();
+    if(!runWorkers(threads, workers, stressWorker)){
+        freeConcurrentTable(&table);
+        return false;
+    }
+    double elapsed = now() - start;
+
+    size_t failures = 0;
+    for(int i = 0; i < threads; i++) failures += workers[i].failures;
+    char key[64];
+    for(int owner = 0; owner < threads; owner++){
+        for(size_t i = 0; i < keys; i++){
+            size_t length = formatKey(key, sizeof(key), owner, i);
+            void* expected = i % 2 == 1 ? encode(i * 2) : NULL;
+            if(getConcurrentEntry(&table, key, length) != expected) failures++;
+        }
+    }
+    size_t expectedCount = sharedKeys + (size_t)threads * (keys / 2);
+    if(concurrentTableCount(&table) != expectedCount) failures++;
+
+    printf("stress: %d threads, %zu keys each, %.3fs, %zu failures\n", threads, keys, elapsed, failures);
+    freeConcurrentTable(&table);
+    return failures == 0;
+}
+
+static void scaling(int maxThreads, size_t keys){
+    ConcurrentTable table;
+    initConcurrentTable(&table);
+    fillShared(&table, keys);
+
+    printf("scaling: %zu keys, %d ops per thread, 90%% lookups\n", keys, SCALING_OPS);
+    printf("%8s %12s %10s\n", "threads", "Mops/s", "speedup");
+    double baseline = 0;
+    for(int threads = 1; threads <= maxThreads; threads *= 2){
+        Worker workers[threads];
+        for(int i = 0; i < threads; i++){
+            workers[i] = (Worker){&table, i, 0, keys, SCALING_OPS, 0, 0x2545f4914f6cdd1dULL * (uint64_t)(i + 1)};
+        }
+        double start = now();
+        if(!runWorkers(threads, workers, scalingWorker)) break;
+        double elapsed = now() - start;
+        double rate = (double)threads * SCALING_OPS / elapsed / 1e6;
+        if(threads == 1) baseline = rate;
+        printf("%8d %12.2f %9.2fx\n", threads, rate, rate / baseline);
+        if(threads < maxThreads && threads * 2 > maxThreads) threads = maxThreads / 2;
+    }
+    freeConcurrentTable(&table);
+}
+
+int main(int argc, char* argv[]){
+    int argi = 1;
+    bool stressOnly = argi < argc && strcmp(argv[argi], "--stress") == 0;
+    if(stressOnly) argi++;
+    int maxThreads = argc > argi ? atoi(argv[argi]) : 8;
+    size_t keys = argc > argi + 1 ? (size_t)strtoull(argv[argi + 1], NULL, 10) : 100000;
+    if(maxThreads < 1 || keys == 0){
+        fprintf(stderr, "Usage: concurrent_bench [--stress] [max-threads] [keys]\n");
+        return 64;
+    }
+    if(!stress(maxThreads, keys / 10 + 1)) return 1;
+    if(!stressOnly) scaling(maxThreads, keys);
+    return 0;
+}
@@ -0,0 +1,215 @@
+#include "corpus.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+static const char* shapeNames[CORPUS_SHAPE_COUNT] = {
+    [CORPUS_NESTING] = "nesting",
+    [CORPUS_OPERATORS] = "operators",
+    [CORPUS_IDENTIFIERS] = "identifiers",
+    [CORPUS_STRINGS] = "strings",
+    [CORPUS_COMMENTS] = "comments",
+    [CORPUS_DEEP_GROUPS] = "deep-groups",
+    [CORPUS_DEEP_UNARY] = "deep-unary",
+    [CORPUS_DEEP_RIGHT] = "deep-right",
+};
+
+static const char* binaryOperators[] = {" + ", " - ", " * ", " / ", " < ", " <= ", " > ", " >= ", " == ", " != "};
+static const char* keywords[] = {"and", "class", "else", "false", "for", "fun", "if", "nil", "or",
+                                 "print", "return", "super", "this", "true", "var", "while"};
+static const char* words[] = {"alpha", "beta", "gamma", "delta", "epsilon", "zeta", "eta", "theta",
+                              "iota", "kappa", "lambda", "mu", "omicron", "sigma", "upsilon", "omega"};
+
+typedef struct{
+    char* chars;
+    size_t length;
+    size_t capacity;
+    uint64_t seed;
+} Builder;
+
+static bool append(Builder* builder, const char* chars, size_t length){
+    if(builder->length + length + 1 > builder->capacity){
+        size_t capacity = builder->capacity * 2;
+        while(capacity < builder->length + length + 1) capacity *= 2;
+        char* grown = (char*)realloc(builder->chars, capacity);
+        if(!grown){
+            fprintf(stderr, "Failed to allocate memory for corpus\n");
+            return false;
+        }
+        builder->chars = grown;
+        builder->capacity = capacity;
+    }
+    memcpy(builder->chars + builder->length, chars, length);
+    builder->length += length;
+    builder->chars[builder->length] = '\0';
+    return true;
+}
+
+static bool appendString(Builder* builder, const char* chars){
+    return append(builder, chars, strlen(chars));
+}
+
+static bool appendFormat(Builder* builder, const char* format, long long number){
+    char buffer[32];
+    int length = snprintf(buffer, sizeof(buffer), format, number);
+    return append(builder, buffer, (size_t)length);
+}
+
+static uint64_t nextRandom(Builder* builder){
+    builder->seed ^= builder->seed << 13;
+    builder->seed ^= builder->seed >> 7;
+    builder->seed ^= builder->seed << 17;
+    return builder->seed;
+}
+
+#define PICK(builder, array) ((array)[nextRandom(builder) % (sizeof(array) / sizeof((array)[0]))])
+
+// (((1 + 1) + 2) + 3)
+static bool appendNesting(Builder* builder, int depth){
+    for(int i = 0; i < depth; i++){
+        if(!append(builder, "(", 1)) return false;
+    }
+    if(!append(builder, "1", 1)) return false;
+    for(int i = 1; i <= depth; i++){
+        if(!appendFormat(builder, " + %lld)", i)) return false;
+    }
+    return true;
+}
+
+static bool appendOperand(Builder* builder){
+    uint64_t r = nextRandom(builder);
+    switch(r % 6){
+        case 0: return appendFormat(builder, "-%lld", (long long)(r >> 8) % 1000);
+        case 1: return appendFormat(builder, "%lld.25", (long long)(r >> 8) % 100000);
+        case 2: return appendString(builder, (r >> 8) & 1 ? "!true" : "nil");
+        default: return appendFormat(builder, "%lld", (long long)(r >> 8) % 1000000);
+    }
+}
+
+static bool appendIdentifier(Builder* builder){
+    uint64_t r = nextRandom(builder);
+    if(r % 4 == 0) return appendString(builder, PICK(builder, keywords));
+    if(!appendString(builder, PICK(builder, words))) return false;
+    return r % 3 == 0 ? appendFormat(builder, "_%lld", (long long)(r >> 8) % 100) : true;
+}
+
+// a small pool of strings repeats, so interning sees hits as well as misses
+static bool appendStringLiteral(Builder* builder){
+    uint64_t r = nextRandom(builder);
+    if(!append(builder, "\"", 1)) return false;
+    int pieces = 1 + (int)(r % 4);
+    for(int i = 0; i < pieces; i++){
+        if(i > 0 && !append(builder, " ", 1)) return false;
+        if(!appendString(builder, PICK(builder, words))) return false;
+    }
+    if(r % 2 == 0 && !appendFormat(builder, " %lld", (long long)(r >> 8) % 10000)) return false;
+    return append(builder, "\"", 1);
+}
+
+static bool appendComment(Builder* builder){
+    if(!append(builder, " //", 3)) return false;
+    int count = 4 + (int)(nextRandom(builder) % 12);
+    for(int i = 0; i < count; i++){
+        if(!append(builder, " ", 1) || !appendString(builder, PICK(builder, words))) return false;
+    }
+    return append(builder, "\n", 1);
+}
+
+// each level opens before the innermost operand and closes after it
+static bool appendDeep(Builder* builder, CorpusShape shape, size_t size){
+    const char* open;
+    const char* close;
+    switch(shape){
+        case CORPUS_DEEP_GROUPS: open = "("; close = ")"; break;
+        case CORPUS_DEEP_UNARY: open = "-"; close = ""; break;
+        case CORPUS_DEEP_RIGHT: open = "1 + ("; close = ")"; break;
+        default: return false;
+    }
+    size_t openLength = strlen(open);
+    size_t closeLength = strlen(close);
+    size_t levels = size / (openLength + closeLength);
+    for(size_t i = 0; i < levels; i++){
+        if(!append(builder, open, openLength)) return false;
+    }
+    if(!append(builder, "1", 1)) return false;
+    for(size_t i = 0; i < levels; i++){
+        if(!append(builder, close, closeLength)) return false;
+    }
+    return true;
+}
+
+static bool appendPiece(Builder* builder, CorpusShape shape, int depth){
+    switch(shape){
+        case CORPUS_NESTING: return appendNesting(builder, depth);
+        case CORPUS_OPERATORS: return appendOperand(builder);
+        case CORPUS_IDENTIFIERS: return appendIdentifier(builder);
+        case CORPUS_STRINGS: return appendStringLiteral(builder);
+        case CORPUS_COMMENTS: return appendOperand(builder) && appendComment(builder);
+        default: return false;
+    }
+}
+
+static bool appendSeparator(Builder* builder, CorpusShape shape){
+    switch(shape){
+        case CORPUS_NESTING: return appendString(builder, " * ");
+        case CORPUS_OPERATORS:
+        case CORPUS_IDENTIFIERS: return appendString(builder, PICK(builder, binaryOperators));
+        case CORPUS_STRINGS: return appendString(builder, " + ");
+        case CORPUS_COMMENTS: return appendString(builder, PICK(builder, binaryOperators) + 1);
+        default: return false;
+    }
+}
+
+const char* corpusShapeName(CorpusShape shape){
+    return shapeNames[shape];
+}
+
+bool corpusShapeFromName(const char* name, CorpusShape* shape){
+    for(int i = 0; i < CORPUS_SHAPE_COUNT; i++){
+        if(strcmp(name, shapeNames[i]) == 0){
+            *shape = (CorpusShape)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool corpusParses(CorpusShape shape){
+    // the grammar has no identifiers yet
+    return shape != CORPUS_IDENTIFIERS;
+}
+
+bool generateCorpus(CorpusShape shape, size_t size, int depth, Corpus* corpus){
+    Builder builder = {NULL, 0, 0, 0x853c49e6748fea9bULL + (uint64_t)shape};
+    builder.capacity = size + 256;
+    builder.chars = (char*)malloc(builder.capacity);
+    if(!builder.chars){
+        fprintf(stderr, "Failed to allocate memory for corpus\n");
+        return false;
+    }
+    builder.chars[0] = '\0';
+    if(shape >= CORPUS_DEEP_GROUPS){
+        if(!appendDeep(&builder, shape, size)) goto failed;
+    }
+    else{
+        if(!appendPiece(&builder, shape, depth)) goto failed;
+        while(builder.length < size){
+            if(!appendSeparator(&builder, shape) || !appendPiece(&builder, shape, depth)) goto failed;
+        }
+    }
+    if(!append(&builder, "\n", 1)) goto failed;
+    corpus->source = builder.chars;
+    corpus->length = builder.length;
+    return true;
+
+failed:
+    free(builder.chars);
+    return false;
+}
+
+void freeCorpus(Corpus* corpus){
+    free(corpus->source);
+    corpus->source = NULL;
+    corpus->length = 0;
+}
@@ -0,0 +1,35 @@
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Synthetic Lox sources for the benchmarks. Every shape except
+// CORPUS_IDENTIFIERS is a single expression the parser accepts.
+typedef enum{
+    CORPUS_NESTING,         // groups of parentheses `depth` levels deep
+    CORPUS_OPERATORS,       // one long chain of binary and unary operators
+    CORPUS_IDENTIFIERS,     // identifiers and keywords; scanned only
+    CORPUS_STRINGS,         // string literals joined by +
+    CORPUS_COMMENTS,        // operands separated by line comments
+    // one expression nested about as deep as the source is long, so a
+    // 2MB deep-groups corpus is 10^6 levels
+    CORPUS_DEEP_GROUPS,     // ((((1))))
+    CORPUS_DEEP_UNARY,      // ----1
+    CORPUS_DEEP_RIGHT,      // 1 + (1 + (1 + 1))
+    CORPUS_SHAPE_COUNT
+} CorpusShape;
+
+typedef struct{
+    char* source;           // NUL-terminated
+    size_t length;
+} Corpus;
+
+const char* corpusShapeName(CorpusShape shape);
+bool corpusShapeFromName(const char* name, CorpusShape* shape);
+bool corpusParses(CorpusShape shape);
+// generates at least `size` bytes; depth only affects CORPUS_NESTING
+bool generateCorpus(CorpusShape shape, size_t size, int depth, Corpus* corpus);
+void freeCorpus(Corpus* corpus);
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef LOX_H
+#define LOX_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+// marks the entry points liblox.so exports; everything else in the
+// library is built hidden
+#if defined(__GNUC__) || defined(__clang__)
+#define LOX_API __attribute__((visibility("default")))
+#else
+#define LOX_API
+#endif
+
+// Embedding API. A context owns everything one interpreter needs: its
+// scanner and parser state, error flags, the arena its trees live in and
+// its intern table. Contexts share nothing, so any number of them can run
+// at once on different threads; a single context must not be used by two
+// threads at the same time.
+typedef struct LoxContext LoxContext;
+
+typedef enum{
+    LOX_OK,
+    LOX_SYNTAX_ERROR,
+    LOX_COMPILE_ERROR,
+    LOX_RUNTIME_ERROR,
+    // the context's memory ran out; the source itself may be fine
+    LOX_OUT_OF_MEMORY
+} LoxResult;
+
+// NULL if memory runs out
+LOX_API LoxContext* loxNewContext();
+LOX_API void loxFreeContext(LoxContext* context);
+// where results and error messages are written; NULL selects stdout or stderr
+LOX_API void loxSetOutput(LoxContext* context, FILE* output, FILE* errors);
+// Runs a program: each statement is optimized, compiled and evaluated,
+// and its value printed, as soon as it is parsed. After the first failure
+// the rest is still parsed, to report its syntax errors, but not run; the
+// result is that first failure. The source need not be NUL-terminated.
+LOX_API LoxResult loxInterpret(LoxContext* context, const char* source, size_t length);
+LOX_API const char* loxVersion();
+
+#endif
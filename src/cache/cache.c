@@ -0,0 +1,588 @@
+#include "cache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../hash/hashtable.h"
+#include "../intern/intern.h"
+#include "../stats/stats.h"
+
+#ifndef LOX_VERSION
+#define LOX_VERSION "dev"
+#endif
+
+// bump whenever the file layout or the meaning of a node changes
+#define AST_CACHE_FORMAT 3
+#define CACHE_SUFFIX ".ast"
+#define BYTE_ORDER_MARK 0x01020304u
+#define NO_PARENT UINT32_MAX
+// the directory is scanned for eviction once this process has written
+// 1/EVICT_FRACTION of the limit since the last scan, or on one store in
+// EVICT_EVERY
+#define EVICT_FRACTION 16
+#define EVICT_EVERY 16
+
+static const char cacheMagic[8] = "LOXAST\0";
+// tells apart temporary files written by threads of one process
+static atomic_ulong temporaryCounter;
+
+// followed by the nodes, the statement table, the string pool and the
+// source the program was parsed from
+typedef struct{
+    char magic[8];
+    uint32_t format;
+    uint32_t byteOrder;
+    uint64_t versionHash;
+    uint64_t sourceHash;
+    uint64_t sourceLength;
+    uint64_t statementCount;
+    uint64_t nodeCount;
+    uint64_t poolSize;
+} CacheHeader;
+
+// the literal's value is an offset and length in the string pool
+#define NODE_STRING 1
+
+// A statement's nodes run from its first, the root, up to the next
+// statement's first; a node's children always have larger indices.
+struct CachedNode{
+    uint8_t type;
+    uint8_t operType;
+    uint8_t flags;
+    uint8_t reserved;
+    int32_t line;
+    // the operator token, as a slice of the source
+    uint32_t operOffset;
+    uint32_t operLength;
+    union{
+        // grouping and unary nodes use left only
+        struct{
+            uint32_t left;
+            uint32_t right;
+        } children;
+        uint64_t value;
+    } as;
+};
+
+typedef struct{
+    Expr* expr;
+    uint32_t parent;
+    bool isRight;
+} PendingNode;
+
+static uint64_t versionHash(){
+    const char* version = LOX_VERSION;
+    return hash(version, strlen(version)) ^ AST_CACHE_FORMAT;
+}
+
+static char* makePath(AstCache* cache, uint64_t sourceHash, size_t length, const char* suffix){
+    size_t size = strlen(cache->directory) + 64;
+    char* path = (char*)malloc(size);
+    if(!path){
+        fprintf(stderr, "Failed to allocate memory for cache path\n");
+        return NULL;
+    }
+    uint64_t key = sourceHash ^ (versionHash() * 0x9e3779b97f4a7c15ULL) ^ length;
+    snprintf(path, size, "%s/%016llx%s", cache->directory, (unsigned long long)key, suffix);
+    return path;
+}
+
+// like mkdir -p
+static bool makeDirectories(char* path){
+    for(char* p = path + 1; *p; p++){
+        if(*p != '/') continue;
+        *p = '\0';
+        bool made = mkdir(path, 0755) == 0 || access(path, F_OK) == 0;
+        *p = '/';
+        if(!made) return false;
+    }
+    return mkdir(path, 0755) == 0 || access(path, F_OK) == 0;
+}
+
+bool initAstCache(AstCache* cache, const char* directory){
+    cache->directory = NULL;
+    cache->limit = AST_CACHE_DEFAULT_LIMIT;
+    atomic_init(&cache->written, 0);
+    const char* limit = getenv("LOX_CACHE_LIMIT");
+    if(limit && strtoull(limit, NULL, 10) > 0){
+        cache->limit = (size_t)strtoull(limit, NULL, 10);
+    }
+
+    char buffer[4096];
+    if(!directory) directory = getenv("LOX_CACHE_DIR");
+    if(!directory){
+        const char* base = getenv("XDG_CACHE_HOME");
+        if(base && *base){
+            snprintf(buffer, sizeof(buffer), "%s/lox", base);
+        }
+        else if((base = getenv("HOME")) && *base){
+            snprintf(buffer, sizeof(buffer), "%s/.cache/lox", base);
+        }
+        else{
+            fprintf(stderr, "No directory for the AST cache; set LOX_CACHE_DIR\n");
+            return false;
+        }
+        directory = buffer;
+    }
+    cache->directory = strdup(directory);
+    if(!cache->directory){
+        fprintf(stderr, "Failed to allocate memory for cache path\n");
+        return false;
+    }
+    if(!makeDirectories(cache->directory)){
+        fprintf(stderr, "Failed to create cache directory \"%s\"\n", cache->directory);
+        freeAstCache(cache);
+        return false;
+    }
+    return true;
+}
+
+void freeAstCache(AstCache* cache){
+    free(cache->directory);
+    cache->directory = NULL;
+}
+
+static const CachedNode* fileNodes(const CacheHeader* header){
+    return (const CachedNode*)(header + 1);
+}
+
+static const uint32_t* fileStatements(const CacheHeader* header){
+    return (const uint32_t*)(fileNodes(header) + header->nodeCount);
+}
+
+static const char* filePool(const CacheHeader* header){
+    return (const char*)(fileStatements(header) + header->statementCount);
+}
+
+static const char* fileSource(const CacheHeader* header){
+    return filePool(header) + header->poolSize;
+}
+
+static bool inStatement(uint32_t child, size_t parent, size_t end){
+    return child > parent && child < end;
+}
+
+// the operators the parser builds each kind of node with
+static bool validOperator(uint8_t type, uint8_t operType){
+    switch(operType){
+        case TOKEN_MINUS:
+            return type == EXPR_BINARY || type == EXPR_UNARY;
+        case TOKEN_BANG:
+            return type == EXPR_UNARY;
+        case TOKEN_PLUS:
+        case TOKEN_SLASH:
+        case TOKEN_STAR:
+        case TOKEN_BANG_EQUAL:
+        case TOKEN_EQUAL_EQUAL:
+        case TOKEN_GREATER:
+        case TOKEN_GREATER_EQUAL:
+        case TOKEN_LESS:
+        case TOKEN_LESS_EQUAL:
+            return type == EXPR_BINARY;
+        default:
+            return false;
+    }
+}
+
+// anything else would be a made-up pointer or a tag no value has
+static bool validLiteral(Value value){
+    return IS_FLOAT(value) || IS_INT(value) || IS_NIL(value) || IS_BOOL(value);
+}
+
+// Checks every index, offset, operator and literal before anything is
+// rebuilt. Children must lie between their parent and the end of its
+// statement, so a damaged file can neither make a cycle nor reach into
+// another statement, and only string literals, re-interned from the pool,
+// can become object values.
+static bool checkProgram(const CacheHeader* header, size_t length){
+    const CachedNode* nodes = fileNodes(header);
+    const uint32_t* statements = fileStatements(header);
+    size_t count = (size_t)header->nodeCount;
+    if(statements[0] != 0) return false;
+    for(size_t s = 0; s < header->statementCount; s++){
+        size_t end = s + 1 < header->statementCount ? statements[s + 1] : count;
+        if(end <= statements[s] || end > count) return false;
+        for(size_t i = statements[s]; i < end; i++){
+            const CachedNode* node = &nodes[i];
+            if((uint64_t)node->operOffset + node->operLength > length) return false;
+            uint32_t left = node->as.children.left;
+            uint32_t right = node->as.children.right;
+            switch(node->type){
+                case EXPR_BINARY:
+                    if(!inStatement(left, i, end) || !inStatement(right, i, end)) return false;
+                    if(!validOperator(node->type, node->operType)) return false;
+                    break;
+                case EXPR_GROUPING:
+                    if(!inStatement(left, i, end)) return false;
+                    break;
+                case EXPR_UNARY:
+                    if(!inStatement(left, i, end)) return false;
+                    if(!validOperator(node->type, node->operType)) return false;
+                    break;
+                case EXPR_LITERAL:
+                    if(node->flags & NODE_STRING){
+                        if((node->as.value >> 32) + (node->as.value & UINT32_MAX) > header->poolSize) return false;
+                    }
+                    else if(!validLiteral(node->as.value)){
+                        return false;
+                    }
+                    break;
+                default:
+                    return false;
+            }
+        }
+    }
+    return true;
+}
+
+// nodes first up to end, already checked, as one arena array
+static Expr* rebuildStatement(const CacheHeader* header, size_t first, size_t end, const char* source, Arena* arena){
+    const CachedNode* nodes = fileNodes(header);
+    const char* pool = filePool(header);
+    STAT_ADD(STAT_NODES, end - first);
+    Expr* exprs = (Expr*)arenaAlloc(arena, sizeof(Expr) * (end - first));
+    if(!exprs) return NULL;
+
+    for(size_t i = first; i < end; i++){
+        const CachedNode* node = &nodes[i];
+        Expr* expr = &exprs[i - first];
+        expr->type = (ExprType)node->type;
+        Token oper = {(TokenType)node->operType, node->line, source + node->operOffset, node->operLength};
+        switch(node->type){
+            case EXPR_BINARY:
+                expr->expression.binary.left = &exprs[node->as.children.left - first];
+                expr->expression.binary.right = &exprs[node->as.children.right - first];
+                expr->expression.binary.oper = oper;
+                break;
+            case EXPR_GROUPING:
+                expr->expression.grouping.expression = &exprs[node->as.children.left - first];
+                break;
+            case EXPR_UNARY:
+                expr->expression.unary.right = &exprs[node->as.children.left - first];
+                expr->expression.unary.oper = oper;
+                break;
+            default:
+                if(node->flags & NODE_STRING){
+                    ObjString* string = internString(pool + (node->as.value >> 32), (size_t)(node->as.value & UINT32_MAX));
+                    if(!string) return NULL;
+                    expr->expression.literal.value = OBJ_VAL(string);
+                }
+                else{
+                    expr->expression.literal.value = node->as.value;
+                }
+                break;
+        }
+    }
+    return exprs;
+}
+
+bool openCachedProgram(AstCache* cache, CachedProgram* program, const char* source, size_t length){
+    program->mapped = NULL;
+    program->size = 0;
+    program->source = source;
+    program->length = length;
+    program->next = 0;
+    uint64_t sourceHash = hash(source, length);
+    char* path = makePath(cache, sourceHash, length, CACHE_SUFFIX);
+    if(!path) return false;
+    int fd = open(path, O_RDONLY);
+    if(fd < 0){
+        free(path);
+        return false;
+    }
+    bool opened = false;
+    bool damaged = true;
+    struct stat info;
+    if(fstat(fd, &info) == 0 && (size_t)info.st_size >= sizeof(CacheHeader)){
+        size_t size = (size_t)info.st_size;
+        void* mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(mapped != MAP_FAILED){
+            const CacheHeader* header = (const CacheHeader*)mapped;
+            // each section is checked against what is left after the ones before it
+            size_t rest = size - sizeof(CacheHeader);
+            bool valid = memcmp(header->magic, cacheMagic, sizeof(cacheMagic)) == 0
+                && header->format == AST_CACHE_FORMAT
+                && header->byteOrder == BYTE_ORDER_MARK
+                && header->versionHash == versionHash()
+                && header->statementCount > 0
+                && header->nodeCount >= header->statementCount
+                && header->nodeCount <= rest / sizeof(CachedNode);
+            if(valid) rest -= (size_t)header->nodeCount * sizeof(CachedNode);
+            valid = valid && header->statementCount <= rest / sizeof(uint32_t);
+            if(valid) rest -= (size_t)header->statementCount * sizeof(uint32_t);
+            valid = valid && header->poolSize <= rest;
+            if(valid) rest -= (size_t)header->poolSize;
+            valid = valid && header->sourceLength == rest;
+            // the hash only picks the file; the source itself must match
+            bool same = valid && header->sourceHash == sourceHash && header->sourceLength == length
+                && memcmp(fileSource(header), source, length) == 0;
+            opened = same && checkProgram(header, length);
+            // a different source under the same key is a collision, not damage
+            damaged = !valid || (same && !opened);
+            if(opened){
+                program->mapped = mapped;
+                program->size = size;
+            }
+            else{
+                munmap(mapped, size);
+            }
+        }
+    }
+    close(fd);
+    if(opened){
+        // the modification time doubles as the last-use stamp for eviction
+        utimensat(AT_FDCWD, path, NULL, 0);
+    }
+    else if(damaged){
+        unlink(path);
+    }
+    free(path);
+    return opened;
+}
+
+bool nextCachedStatement(CachedProgram* program, Arena* arena, Expr** statement){
+    *statement = NULL;
+    const CacheHeader* header = (const CacheHeader*)program->mapped;
+    if(!header || program->next >= header->statementCount) return false;
+    const uint32_t* statements = fileStatements(header);
+    size_t first = statements[program->next++];
+    size_t end = program->next < header->statementCount ? statements[program->next] : (size_t)header->nodeCount;
+    *statement = rebuildStatement(header, first, end, program->source, arena);
+    return true;
+}
+
+void closeCachedProgram(CachedProgram* program){
+    if(program->mapped) munmap(program->mapped, program->size);
+    program->mapped = NULL;
+}
+
+static bool reserve(void** items, size_t* capacity, size_t needed, size_t itemSize){
+    if(needed <= *capacity) return true;
+    size_t grown = *capacity < 64 ? 64 : *capacity;
+    while(grown < needed) grown *= 2;
+    void* resized = realloc(*items, grown * itemSize);
+    if(!resized){
+        fprintf(stderr, "Failed to allocate memory for cache file\n");
+        return false;
+    }
+    *items = resized;
+    *capacity = grown;
+    return true;
+}
+
+static bool setOperator(CachedNode* node, Token oper, const char* source, size_t length){
+    if(oper.lexeme < source || oper.lexeme + oper.length > source + length) return false;
+    node->operType = (uint8_t)oper.type;
+    node->operOffset = (uint32_t)(oper.lexeme - source);
+    node->operLength = (uint32_t)oper.length;
+    node->line = oper.line;
+    return true;
+}
+
+void initCacheBuilder(CacheBuilder* builder){
+    builder->nodes = NULL;
+    builder->count = 0;
+    builder->capacity = 0;
+    builder->pool = NULL;
+    builder->poolSize = 0;
+    builder->poolCapacity = 0;
+    builder->statements = NULL;
+    builder->statementCount = 0;
+    builder->statementCapacity = 0;
+    builder->ok = true;
+}
+
+void freeCacheBuilder(CacheBuilder* builder){
+    free(builder->nodes);
+    free(builder->pool);
+    free(builder->statements);
+    initCacheBuilder(builder);
+}
+
+// Flattens the tree with an explicit stack (operator chains are as deep
+// as they are long). Each node is appended when popped, and then patched
+// into its parent, so children always land after their parent.
+void addCachedStatement(CacheBuilder* builder, Expr* root, const char* source, size_t length){
+    if(!builder->ok) return;
+    PendingNode* stack = NULL;
+    size_t top = 0, stackCapacity = 0;
+    size_t first = builder->count;
+    bool ok = first < UINT32_MAX
+        && reserve((void**)&builder->statements, &builder->statementCapacity, builder->statementCount + 1, sizeof(uint32_t))
+        && reserve((void**)&stack, &stackCapacity, 1, sizeof(PendingNode));
+    if(ok) stack[top++] = (PendingNode){root, NO_PARENT, false};
+
+    while(ok && top > 0){
+        PendingNode pending = stack[--top];
+        Expr* expr = pending.expr;
+        if(!expr || builder->count >= UINT32_MAX
+           || !reserve((void**)&builder->nodes, &builder->capacity, builder->count + 1, sizeof(CachedNode))
+           || !reserve((void**)&stack, &stackCapacity, top + 2, sizeof(PendingNode))){
+            ok = false;
+            break;
+        }
+        CachedNode* nodes = builder->nodes;
+        uint32_t index = (uint32_t)builder->count++;
+        CachedNode* node = &nodes[index];
+        memset(node, 0, sizeof(CachedNode));
+        node->type = (uint8_t)expr->type;
+        if(pending.parent != NO_PARENT){
+            if(pending.isRight) nodes[pending.parent].as.children.right = index;
+            else nodes[pending.parent].as.children.left = index;
+        }
+        switch(expr->type){
+            case EXPR_BINARY:
+                ok = setOperator(node, expr->expression.binary.oper, source, length);
+                stack[top++] = (PendingNode){expr->expression.binary.right, index, true};
+                stack[top++] = (PendingNode){expr->expression.binary.left, index, false};
+                break;
+            case EXPR_GROUPING:
+                stack[top++] = (PendingNode){expr->expression.grouping.expression, index, false};
+                break;
+            case EXPR_UNARY:
+                ok = setOperator(node, expr->expression.unary.oper, source, length);
+                stack[top++] = (PendingNode){expr->expression.unary.right, index, false};
+                break;
+            case EXPR_LITERAL: {
+                Value value = expr->expression.literal.value;
+                if(!IS_STRING(value)){
+                    node->as.value = value;
+                    break;
+                }
+                ObjString* string = AS_STRING(value);
+                if(string->length > UINT32_MAX
+                   || !reserve((void**)&builder->pool, &builder->poolCapacity, builder->poolSize + string->length + 1, 1)){
+                    ok = false;
+                    break;
+                }
+                memcpy(builder->pool + builder->poolSize, string->chars, string->length);
+                node->flags = NODE_STRING;
+                node->as.value = ((uint64_t)builder->poolSize << 32) | string->length;
+                builder->poolSize += string->length;
+                if(builder->poolSize > UINT32_MAX) ok = false;
+                break;
+            }
+            default:
+                ok = false;
+        }
+    }
+    free(stack);
+    if(ok) builder->statements[builder->statementCount++] = (uint32_t)first;
+    builder->ok = ok;
+}
+
+static bool writeAll(int fd, const void* data, size_t size){
+    const char* p = (const char*)data;
+    while(size > 0){
+        ssize_t written = write(fd, p, size);
+        if(written <= 0) return false;
+        p += written;
+        size -= (size_t)written;
+    }
+    return true;
+}
+
+typedef struct{
+    char* name;
+    off_t size;
+    struct timespec used;
+} CacheEntry;
+
+static int compareLastUse(const void* a, const void* b){
+    const CacheEntry* left = (const CacheEntry*)a;
+    const CacheEntry* right = (const CacheEntry*)b;
+    if(left->used.tv_sec != right->used.tv_sec) return left->used.tv_sec < right->used.tv_sec ? -1 : 1;
+    if(left->used.tv_nsec != right->used.tv_nsec) return left->used.tv_nsec < right->used.tv_nsec ? -1 : 1;
+    return 0;
+}
+
+// deletes least recently used files until the directory fits the limit
+static void evict(AstCache* cache){
+    DIR* dir = opendir(cache->directory);
+    if(!dir) return;
+    CacheEntry* entries = NULL;
+    size_t count = 0, capacity = 0;
+    size_t total = 0;
+    size_t suffixLength = strlen(CACHE_SUFFIX);
+    struct dirent* entry;
+    while((entry = readdir(dir))){
+        size_t nameLength = strlen(entry->d_name);
+        if(nameLength <= suffixLength || strcmp(entry->d_name + nameLength - suffixLength, CACHE_SUFFIX) != 0) continue;
+        struct stat info;
+        if(fstatat(dirfd(dir), entry->d_name, &info, 0) != 0 || !S_ISREG(info.st_mode)) continue;
+        if(!reserve((void**)&entries, &capacity, count + 1, sizeof(CacheEntry))) break;
+        char* name = strdup(entry->d_name);
+        if(!name) break;
+        entries[count++] = (CacheEntry){name, info.st_size, info.st_mtim};
+        total += (size_t)info.st_size;
+    }
+    if(total > cache->limit){
+        qsort(entries, count, sizeof(CacheEntry), compareLastUse);
+        for(size_t i = 0; i < count && total > cache->limit; i++){
+            // another process may have removed it already, which is just as good
+            unlinkat(dirfd(dir), entries[i].name, 0);
+            total -= (size_t)entries[i].size;
+        }
+    }
+    for(size_t i = 0; i < count; i++) free(entries[i].name);
+    free(entries);
+    closedir(dir);
+}
+
+bool storeCachedProgram(AstCache* cache, CacheBuilder* builder, const char* source, size_t length){
+    // offsets into the source are 32 bits wide
+    if(!builder->ok || builder->statementCount == 0 || length > UINT32_MAX) return false;
+
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.format = AST_CACHE_FORMAT;
+    header.byteOrder = BYTE_ORDER_MARK;
+    header.versionHash = versionHash();
+    header.sourceHash = hash(source, length);
+    header.sourceLength = length;
+    header.statementCount = builder->statementCount;
+    header.nodeCount = builder->count;
+    header.poolSize = builder->poolSize;
+
+    bool stored = false;
+    char* path = makePath(cache, header.sourceHash, length, CACHE_SUFFIX);
+    char suffix[48];
+    // written under a private name and renamed, so readers never see half a file
+    snprintf(suffix, sizeof(suffix), CACHE_SUFFIX ".%ld.%lu.tmp", (long)getpid(), atomic_fetch_add(&temporaryCounter, 1));
+    char* temporary = makePath(cache, header.sourceHash, length, suffix);
+    if(path && temporary){
+        int fd = open(temporary, O_WRONLY | O_CREAT | O_EXCL, 0644);
+        if(fd >= 0){
+            bool written = writeAll(fd, &header, sizeof(header))
+                && writeAll(fd, builder->nodes, builder->count * sizeof(CachedNode))
+                && writeAll(fd, builder->statements, builder->statementCount * sizeof(uint32_t))
+                && writeAll(fd, builder->pool, builder->poolSize)
+                && writeAll(fd, source, length);
+            written = close(fd) == 0 && written;
+            stored = written && rename(temporary, path) == 0;
+            if(!stored) unlink(temporary);
+        }
+    }
+    free(path);
+    free(temporary);
+    if(stored){
+        size_t written = sizeof(header) + builder->count * sizeof(CachedNode)
+            + builder->statementCount * sizeof(uint32_t) + builder->poolSize + length;
+        // one store in EVICT_EVERY also scans, so short-lived processes
+        // that each store little still keep the directory in bounds
+        bool due = atomic_fetch_add(&cache->written, written) + written >= cache->limit / EVICT_FRACTION
+            || header.sourceHash % EVICT_EVERY == 0;
+        if(due){
+            atomic_store(&cache->written, 0);
+            evict(cache);
+        }
+    }
+    return stored;
+}
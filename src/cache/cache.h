@@ -0,0 +1,93 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "../expression/expression.h"
+#include "../memory/arena.h"
+
+// Parsed programs saved on disk, keyed by a hash of the source bytes and
+// the interpreter version. A file also holds the source it was parsed
+// from, and a hit must match it byte for byte, so a hash collision is a
+// miss rather than another program's tree.
+//
+// A cache file is a header, a flat array of fixed-size nodes that refer
+// to each other by index, the index of each top-level statement's first
+// node, a pool of string literal bytes and the source. Nothing in it is a pointer, so
+// a file is loaded by mapping it and rebuilding one statement's tree at a
+// time in a linear pass: child indices become addresses in an arena array,
+// operator lexemes become offsets into the (identical) source, and string
+// literals are re-interned.
+//
+// The nodes are rebuilt rather than used in place: the optimizer rewrites
+// trees in place, which a read-only mapping shared with other processes
+// cannot allow, string literals must become this process's interned
+// pointers, and every walker reads Expr. The rebuild is a single copy per
+// node with no lookups beyond the interning, and it only ever holds one
+// statement, so mapping still saves the whole scan and parse.
+//
+// Files are replaced atomically. When the directory grows past its limit
+// the least recently used files are deleted; a hit refreshes a file's
+// modification time, which serves as its last-use stamp. Finding them
+// takes a scan of the directory, so it is only done once a process has
+// written a sixteenth of the limit since its last scan, or on one store
+// in sixteen; the directory can overshoot the limit by about that much.
+#define AST_CACHE_DEFAULT_LIMIT ((size_t)64 << 20)
+
+typedef struct{
+    char* directory;
+    size_t limit;
+    // bytes this process has stored since the directory was last scanned
+    atomic_size_t written;
+} AstCache;
+
+typedef struct CachedNode CachedNode;
+
+// A program's statements, copied in as they are parsed so that each tree
+// can be released once it has run.
+typedef struct{
+    CachedNode* nodes;
+    size_t count;
+    size_t capacity;
+    char* pool;
+    size_t poolSize;
+    size_t poolCapacity;
+    // first node of each statement
+    uint32_t* statements;
+    size_t statementCount;
+    size_t statementCapacity;
+    // cleared when a statement could not be added
+    bool ok;
+} CacheBuilder;
+
+// a mapped cache file, read back a statement at a time
+typedef struct{
+    void* mapped;
+    size_t size;
+    const char* source;
+    size_t length;
+    size_t next;
+} CachedProgram;
+
+// directory NULL picks $LOX_CACHE_DIR, $XDG_CACHE_HOME/lox or ~/.cache/lox;
+// $LOX_CACHE_LIMIT (bytes) overrides the default limit
+bool initAstCache(AstCache* cache, const char* directory);
+void freeAstCache(AstCache* cache);
+
+// false on a miss or an unusable file; the whole file is checked here, so
+// reading it back only fails if memory runs out
+bool openCachedProgram(AstCache* cache, CachedProgram* program, const char* source, size_t length);
+// false after the last statement; otherwise *statement is its tree,
+// rebuilt in arena, or NULL if memory ran out
+bool nextCachedStatement(CachedProgram* program, Arena* arena, Expr** statement);
+void closeCachedProgram(CachedProgram* program);
+
+void initCacheBuilder(CacheBuilder* builder);
+// copies the tree, so add a statement before the optimizer rewrites it
+void addCachedStatement(CacheBuilder* builder, Expr* root, const char* source, size_t length);
+bool storeCachedProgram(AstCache* cache, CacheBuilder* builder, const char* source, size_t length);
+void freeCacheBuilder(CacheBuilder* builder);
+
+#endif
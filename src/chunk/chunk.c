@@ -0,0 +1,79 @@
+#include "chunk.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include "../stats/stats.h"
+#include "../output/output.h"
+
+void initChunk(Chunk* chunk){
+    chunk->code = NULL;
+    chunk->count = 0;
+    chunk->capacity = 0;
+    chunk->lines = NULL;
+    chunk->lineCount = 0;
+    chunk->lineCapacity = 0;
+    chunk->maxStack = 0;
+    chunk->failed = false;
+    initValueArray(&chunk->constants);
+}
+
+static void addLine(Chunk* chunk, int line){
+    if(chunk->lineCount > 0 && chunk->lines[chunk->lineCount-1].line == line){
+        return;
+    }
+    if(chunk->lineCount >= chunk->lineCapacity){
+        size_t capacity = chunk->lineCapacity < 8 ? 8 : chunk->lineCapacity * 2;
+        STAT_ALLOC(sizeof(LineStart) * capacity);
+        LineStart* lines = (LineStart*)realloc(chunk->lines, sizeof(LineStart) * capacity);
+        if(!lines){
+            fprintf(errorStream(), "Failure to reallocate memory for chunk lines\n");
+            chunk->failed = true;
+            return;
+        }
+        chunk->lines = lines;
+        chunk->lineCapacity = capacity;
+    }
+    chunk->lines[chunk->lineCount].offset = chunk->count;
+    chunk->lines[chunk->lineCount].line = line;
+    chunk->lineCount++;
+}
+
+void writeChunk(Chunk* chunk, uint8_t byte, int line){
+    if(chunk->count >= chunk->capacity){
+        size_t capacity = chunk->capacity < 8 ? 8 : chunk->capacity * 2;
+        STAT_ALLOC(capacity);
+        uint8_t* code = (uint8_t*)realloc(chunk->code, capacity);
+        if(!code){
+            fprintf(errorStream(), "Failure to reallocate memory for chunk\n");
+            chunk->failed = true;
+            return;
+        }
+        chunk->code = code;
+        chunk->capacity = capacity;
+    }
+    addLine(chunk, line);
+    chunk->code[chunk->count++] = byte;
+}
+
+size_t addConstant(Chunk* chunk, Value value){
+    // a failed chunk is never run, so the index it gets does not matter
+    if(!writeValueArray(&chunk->constants, value)) chunk->failed = true;
+    return chunk->constants.count ? chunk->constants.count - 1 : 0;
+}
+
+int getLine(Chunk* chunk, size_t offset){
+    size_t low = 0;
+    size_t high = chunk->lineCount;
+    while(high - low > 1){
+        size_t mid = low + (high - low) / 2;
+        if(chunk->lines[mid].offset <= offset) low = mid;
+        else high = mid;
+    }
+    return chunk->lineCount ? chunk->lines[low].line : 0;
+}
+
+void freeChunk(Chunk* chunk){
+    free(chunk->code);
+    free(chunk->lines);
+    freeValueArray(&chunk->constants);
+    initChunk(chunk);
+}
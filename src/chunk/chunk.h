@@ -0,0 +1,58 @@
+#ifndef CHUNK_H
+#define CHUNK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "../value/value.h"
+
+typedef enum OpCode{
+    OP_CONSTANT,
+    OP_CONSTANT_LONG,
+    OP_NIL,
+    OP_TRUE,
+    OP_FALSE,
+    OP_EQUAL,
+    OP_NOT_EQUAL,
+    OP_GREATER,
+    OP_GREATER_EQUAL,
+    OP_LESS,
+    OP_LESS_EQUAL,
+    OP_ADD,
+    OP_SUBTRACT,
+    OP_MULTIPLY,
+    OP_DIVIDE,
+    OP_NOT,
+    OP_NEGATE,
+    OP_RETURN
+} OpCode;
+
+// lines are run-length encoded: each entry marks the first offset of a line
+typedef struct{
+    size_t offset;
+    int line;
+} LineStart;
+
+typedef struct{
+    uint8_t* code;
+    size_t count;
+    size_t capacity;
+    LineStart* lines;
+    size_t lineCount;
+    size_t lineCapacity;
+    ValueArray constants;
+    // deepest the value stack can get while running this chunk
+    size_t maxStack;
+    // set when a byte, line or constant could not be stored; the chunk is
+    // then incomplete and must not be run
+    bool failed;
+} Chunk;
+
+void initChunk(Chunk* chunk);
+// both set failed if memory runs out
+void writeChunk(Chunk* chunk, uint8_t byte, int line);
+size_t addConstant(Chunk* chunk, Value value);
+int getLine(Chunk* chunk, size_t offset);
+void freeChunk(Chunk* chunk);
+
+#endif
@@ -0,0 +1,188 @@
+#include "compiler.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MAX_CONSTANTS (1 << 24)
+
+typedef struct{
+    Chunk* chunk;
+    int line;
+    size_t stackDepth;
+    FILE* errors;
+    bool hadError;
+} Compiler;
+
+// a node waiting to be compiled; expanded once its children have been
+// queued ahead of it, so its own instruction follows theirs
+typedef struct{
+    Expr* expr;
+    bool expanded;
+} PendingExpr;
+
+static void error(Compiler* compiler, char* message){
+    fprintf(compiler->errors, "[line %d] Compile error: %s\n", compiler->line, message);
+    compiler->hadError = true;
+}
+
+static void emitByte(Compiler* compiler, uint8_t byte){
+    writeChunk(compiler->chunk, byte, compiler->line);
+}
+
+// tracks how deep the value stack gets so the VM can size it up front
+static void push(Compiler* compiler){
+    compiler->stackDepth++;
+    if(compiler->stackDepth > compiler->chunk->maxStack){
+        compiler->chunk->maxStack = compiler->stackDepth;
+    }
+}
+
+static void pop(Compiler* compiler){
+    compiler->stackDepth--;
+}
+
+static void emitConstant(Compiler* compiler, Value value){
+    size_t index = addConstant(compiler->chunk, value);
+    if(index < 256){
+        emitByte(compiler, OP_CONSTANT);
+        emitByte(compiler, (uint8_t)index);
+    }
+    else if(index < MAX_CONSTANTS){
+        emitByte(compiler, OP_CONSTANT_LONG);
+        emitByte(compiler, (uint8_t)(index & 0xff));
+        emitByte(compiler, (uint8_t)((index >> 8) & 0xff));
+        emitByte(compiler, (uint8_t)((index >> 16) & 0xff));
+    }
+    else{
+        error(compiler, "Too many constants in one chunk.");
+    }
+    push(compiler);
+}
+
+static void compileLiteral(Compiler* compiler, LiteralExpr* literal){
+    Value value = literal->value;
+    if(IS_NIL(value)){
+        emitByte(compiler, OP_NIL);
+        push(compiler);
+    }
+    else if(IS_BOOL(value)){
+        emitByte(compiler, AS_BOOL(value) ? OP_TRUE : OP_FALSE);
+        push(compiler);
+    }
+    else{
+        emitConstant(compiler, value);
+    }
+}
+
+// operands are compiled before the operator
+static void compileUnary(Compiler* compiler, UnaryExpr* unary){
+    compiler->line = unary->oper.line;
+    switch(unary->oper.type){
+        case TOKEN_BANG:
+            emitByte(compiler, OP_NOT);
+            break;
+        case TOKEN_MINUS:
+            emitByte(compiler, OP_NEGATE);
+            break;
+        default:
+            error(compiler, "Unknown unary operator.");
+            break;
+    }
+}
+
+static void compileBinary(Compiler* compiler, BinaryExpr* binary){
+    compiler->line = binary->oper.line;
+    switch(binary->oper.type){
+        case TOKEN_BANG_EQUAL: emitByte(compiler, OP_NOT_EQUAL); break;
+        case TOKEN_EQUAL_EQUAL: emitByte(compiler, OP_EQUAL); break;
+        case TOKEN_GREATER: emitByte(compiler, OP_GREATER); break;
+        case TOKEN_GREATER_EQUAL: emitByte(compiler, OP_GREATER_EQUAL); break;
+        case TOKEN_LESS: emitByte(compiler, OP_LESS); break;
+        case TOKEN_LESS_EQUAL: emitByte(compiler, OP_LESS_EQUAL); break;
+        case TOKEN_PLUS: emitByte(compiler, OP_ADD); break;
+        case TOKEN_MINUS: emitByte(compiler, OP_SUBTRACT); break;
+        case TOKEN_STAR: emitByte(compiler, OP_MULTIPLY); break;
+        case TOKEN_SLASH: emitByte(compiler, OP_DIVIDE); break;
+        default:
+            error(compiler, "Unknown binary operator.");
+            return;
+    }
+    pop(compiler);
+}
+
+static void compileNode(Compiler* compiler, Expr* expr){
+    switch(expr->type){
+        case EXPR_BINARY:
+            compileBinary(compiler, &expr->expression.binary);
+            break;
+        case EXPR_GROUPING:
+            break;
+        case EXPR_LITERAL:
+            compileLiteral(compiler, &expr->expression.literal);
+            break;
+        case EXPR_UNARY:
+            compileUnary(compiler, &expr->expression.unary);
+            break;
+    }
+}
+
+// a postorder walk with an explicit stack, so depth is bounded by memory
+static void compileExpr(Compiler* compiler, Expr* root){
+    size_t count = 0;
+    size_t capacity = 64;
+    PendingExpr* pending = (PendingExpr*)malloc(capacity * sizeof(PendingExpr));
+    if(!pending){
+        error(compiler, "Out of memory.");
+        return;
+    }
+    pending[count++] = (PendingExpr){root, false};
+    while(count > 0){
+        PendingExpr item = pending[--count];
+        Expr* expr = item.expr;
+        if(!expr){
+            error(compiler, "Missing expression.");
+            continue;
+        }
+        if(item.expanded || expr->type == EXPR_LITERAL){
+            compileNode(compiler, expr);
+            continue;
+        }
+        if(count + 3 > capacity){
+            PendingExpr* grown = (PendingExpr*)realloc(pending, capacity * 2 * sizeof(PendingExpr));
+            if(!grown){
+                error(compiler, "Out of memory.");
+                break;
+            }
+            pending = grown;
+            capacity *= 2;
+        }
+        // the left operand is popped, and so compiled, first
+        pending[count++] = (PendingExpr){expr, true};
+        switch(expr->type){
+            case EXPR_BINARY:
+                pending[count++] = (PendingExpr){expr->expression.binary.right, false};
+                pending[count++] = (PendingExpr){expr->expression.binary.left, false};
+                break;
+            case EXPR_UNARY:
+                pending[count++] = (PendingExpr){expr->expression.unary.right, false};
+                break;
+            case EXPR_GROUPING:
+                pending[count++] = (PendingExpr){expr->expression.grouping.expression, false};
+                break;
+            case EXPR_LITERAL:
+                break;
+        }
+    }
+    free(pending);
+}
+
+bool compile(Expr* expr, Chunk* chunk, FILE* errors){
+    Compiler compiler;
+    compiler.chunk = chunk;
+    compiler.errors = errors;
+    compiler.line = 1;
+    compiler.stackDepth = 0;
+    compiler.hadError = false;
+    compileExpr(&compiler, expr);
+    emitByte(&compiler, OP_RETURN);
+    return !compiler.hadError && !chunk->failed;
+}
@@ -0,0 +1,13 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "../expression/expression.h"
+#include "../chunk/chunk.h"
+
+// lowers the expression tree into chunk, ending it with OP_RETURN; errors
+// are printed to errors. False on an error or if the chunk ran out of memory.
+bool compile(Expr* expr, Chunk* chunk, FILE* errors);
+
+#endif
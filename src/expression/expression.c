@@ -1,9 +1,11 @@
 #include "expression.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include "../stats/stats.h"
 
-Expr* newBinaryExpr(Expr* left,Token oper, Expr* right){
-    Expr* expr = (Expr*)malloc(sizeof(Expr));
+Expr* newBinaryExpr(Arena* arena, Expr* left,Token oper, Expr* right){
+    STAT_ADD(STAT_NODES, 1);
+    Expr* expr = (Expr*)arenaAlloc(arena, sizeof(Expr));
     if(!expr){
         fprintf(stderr, "Failed to allocate memory for binary expression");
         return NULL;
@@ -15,8 +17,9 @@ Expr* newBinaryExpr(Expr* left,Token oper, Expr* right){
     return expr;
 }
 
-Expr* newGroupingExpr(Expr* expression){
-    Expr* expr = (Expr*)malloc(sizeof(Expr));
+Expr* newGroupingExpr(Arena* arena, Expr* expression){
+    STAT_ADD(STAT_NODES, 1);
+    Expr* expr = (Expr*)arenaAlloc(arena, sizeof(Expr));
     if(!expr){
         fprintf(stderr, "Failed to allocate memory for grouping expression");
         return NULL;
@@ -26,40 +29,21 @@ Expr* newGroupingExpr(Expr* expression){
     return expr;
 }
 
-Expr* newLiteralExpr(LiteralValue value, LiteralType type){
-    Expr* expr = (Expr*)malloc(sizeof(Expr));
+Expr* newLiteralExpr(Arena* arena, Value value){
+    STAT_ADD(STAT_NODES, 1);
+    Expr* expr = (Expr*)arenaAlloc(arena, sizeof(Expr));
     if(!expr){
         fprintf(stderr, "Failed to allocate memory for literal expression");
         return NULL;
     }
     expr->type = EXPR_LITERAL;
-    expr->expression.literal.type = type;
-    switch(type){
-        case LITERAL_INTEGER:
-            expr->expression.literal.value.number.integer = value.number.integer;
-            break;
-        case LITERAL_FLOAT:
-            expr->expression.literal.value.number.floating = value.number.floating;
-            break;
-        case LITERAL_BOOLEAN:
-            expr->expression.literal.value.boolean = value.boolean;
-            break;
-        case LITERAL_STRING:
-            expr->expression.literal.value.string = (char*)value.string;
-            break;
-        case LITERAL_NIL:
-            expr->expression.literal.value.nil = NULL;
-            break;
-        default:
-            fprintf(stderr, "Invalid literal type");
-            free(expr);
-            break;
-    }
+    expr->expression.literal.value = value;
     return expr;
 }
 
-Expr* newUnaryExpr(Token oper, Expr* right){
-    Expr* expr = (Expr*)malloc(sizeof(Expr));
+Expr* newUnaryExpr(Arena* arena, Token oper, Expr* right){
+    STAT_ADD(STAT_NODES, 1);
+    Expr* expr = (Expr*)arenaAlloc(arena, sizeof(Expr));
     if(!expr){
         fprintf(stderr, "Failed to allocate memory for unary expression");
         return NULL;
@@ -69,29 +53,3 @@ Expr* newUnaryExpr(Token oper, Expr* right){
     expr->expression.unary.right = right;
     return expr;
 }
-
-void freeExpr(Expr* expr){
-    if(!expr){
-        fprintf(stderr, "Invalid expression");
-        return;
-    }
-    switch(expr->type){
-        case EXPR_BINARY:
-            freeExpr(expr->expression.binary.left);
-            freeExpr(expr->expression.binary.right);
-            break;
-        case EXPR_UNARY:
-            freeExpr(expr->expression.unary.right);
-            break;
-        case EXPR_GROUPING:
-            freeExpr(expr->expression.grouping.expression);
-            break;
-        case EXPR_LITERAL:
-            switch(expr->expression.literal.type){
-                case LITERAL_STRING:
-                    free(expr->expression.literal.value.string);
-                    break;
-            }
-    }
-    free(expr);
-}
\ No newline at end of file
@@ -2,6 +2,8 @@
 #define EXPRESSION_H
 
 #include "../scanner/scanner.h"
+#include "../memory/arena.h"
+#include "../value/value.h"
 
 typedef struct Expr Expr;
 typedef struct BinaryExpr BinaryExpr;
@@ -27,29 +29,10 @@ typedef struct GroupingExpr{
     Expr* expression;
 } GroupingExpr;
 
-typedef enum LiteralType{
-    LITERAL_INTEGER,
-    LITERAL_FLOAT,
-    LITERAL_STRING,
-    LITERAL_BOOLEAN,
-    LITERAL_NIL
-} LiteralType;
-
-typedef union Number{
-    double floating;
-    int integer;
-} Number;
-
-typedef union LiteralValue{
-    Number number;
-    char* string;
-    bool boolean;
-    void* nil;
-} LiteralValue;
-
+// string literals are interned ObjStrings, living in the intern table's
+// own arena, so they outlive the tree's arena being reset
 typedef struct LiteralExpr{
-    LiteralType type;
-    LiteralValue value;
+    Value value;
 } LiteralExpr;
 
 typedef struct UnaryExpr{
@@ -67,10 +50,10 @@ typedef struct Expr{
     } expression;
 } Expr;
 
-Expr* newBinaryExpr(Expr* left, Token oper, Expr* right);
-Expr* newGroupingExpr(Expr* expression);
-Expr* newLiteralExpr(LiteralValue value, LiteralType type);
-Expr* newUnaryExpr(Token oper, Expr* right);
-void freeExpr(Expr* expr);
+// nodes live in the arena and are released together with it
+Expr* newBinaryExpr(Arena* arena, Expr* left, Token oper, Expr* right);
+Expr* newGroupingExpr(Arena* arena, Expr* expression);
+Expr* newLiteralExpr(Arena* arena, Value value);
+Expr* newUnaryExpr(Arena* arena, Token oper, Expr* right);
 
 #endif
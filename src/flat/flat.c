@@ -0,0 +1,263 @@
+#include "flat.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../output/output.h"
+#include "../value/arith.h"
+
+// a node of the pointer tree waiting to be flattened; expanded once its
+// children have been queued ahead of it
+typedef struct{
+    Expr* expr;
+    bool expanded;
+} PendingExpr;
+
+void initFlatTree(FlatTree* tree){
+    tree->nodes = NULL;
+    tree->count = 0;
+    tree->capacity = 0;
+    tree->maxStack = 0;
+}
+
+void freeFlatTree(FlatTree* tree){
+    free(tree->nodes);
+    initFlatTree(tree);
+}
+
+// grows *array to hold at least needed elements of the given size
+static bool reserve(void** array, size_t* capacity, size_t needed, size_t size){
+    if(needed <= *capacity) return true;
+    size_t grown = *capacity < 64 ? 64 : *capacity * 2;
+    if(grown < needed) grown = needed;
+    void* resized = realloc(*array, grown * size);
+    if(!resized){
+        fprintf(stderr, "Failure to reallocate memory for flat tree");
+        return false;
+    }
+    *array = resized;
+    *capacity = grown;
+    return true;
+}
+
+static bool operatorKind(Expr* expr, uint8_t* kind){
+    if(expr->type == EXPR_UNARY){
+        switch(expr->expression.unary.oper.type){
+            case TOKEN_MINUS: *kind = FLAT_NEGATE; return true;
+            case TOKEN_BANG: *kind = FLAT_NOT; return true;
+            default: return false;
+        }
+    }
+    switch(expr->expression.binary.oper.type){
+        case TOKEN_PLUS: *kind = FLAT_ADD; return true;
+        case TOKEN_MINUS: *kind = FLAT_SUBTRACT; return true;
+        case TOKEN_STAR: *kind = FLAT_MULTIPLY; return true;
+        case TOKEN_SLASH: *kind = FLAT_DIVIDE; return true;
+        case TOKEN_EQUAL_EQUAL: *kind = FLAT_EQUAL; return true;
+        case TOKEN_BANG_EQUAL: *kind = FLAT_NOT_EQUAL; return true;
+        case TOKEN_GREATER: *kind = FLAT_GREATER; return true;
+        case TOKEN_GREATER_EQUAL: *kind = FLAT_GREATER_EQUAL; return true;
+        case TOKEN_LESS: *kind = FLAT_LESS; return true;
+        case TOKEN_LESS_EQUAL: *kind = FLAT_LESS_EQUAL; return true;
+        default: return false;
+    }
+}
+
+bool flattenExpr(FlatTree* tree, Expr* root){
+    tree->count = 0;
+    tree->maxStack = 0;
+    size_t treeCapacity = tree->capacity;
+    PendingExpr* pending = NULL;
+    size_t pendingCount = 0;
+    size_t pendingCapacity = 0;
+    // indices of flattened nodes whose parent is still pending
+    uint32_t* finished = NULL;
+    size_t finishedCount = 0;
+    size_t finishedCapacity = 0;
+    uint32_t depth = 0;
+    bool ok = reserve((void**)&pending, &pendingCapacity, 1, sizeof(PendingExpr));
+    if(ok) pending[pendingCount++] = (PendingExpr){root, false};
+
+    while(ok && pendingCount > 0){
+        PendingExpr item = pending[--pendingCount];
+        Expr* expr = item.expr;
+        if(!expr){
+            fprintf(errorStream(), "Cannot flatten a tree with missing operands\n");
+            ok = false;
+            break;
+        }
+        if(!item.expanded && expr->type != EXPR_LITERAL){
+            // the left child is popped, and so flattened, first
+            ok = reserve((void**)&pending, &pendingCapacity, pendingCount + 3, sizeof(PendingExpr));
+            if(!ok) break;
+            pending[pendingCount++] = (PendingExpr){expr, true};
+            switch(expr->type){
+                case EXPR_BINARY:
+                    pending[pendingCount++] = (PendingExpr){expr->expression.binary.right, false};
+                    pending[pendingCount++] = (PendingExpr){expr->expression.binary.left, false};
+                    break;
+                case EXPR_UNARY:
+                    pending[pendingCount++] = (PendingExpr){expr->expression.unary.right, false};
+                    break;
+                case EXPR_GROUPING:
+                    pending[pendingCount++] = (PendingExpr){expr->expression.grouping.expression, false};
+                    break;
+                case EXPR_LITERAL:
+                    break;
+            }
+            continue;
+        }
+
+        if(tree->count >= FLAT_MAX_NODES){
+            fprintf(errorStream(), "Too many nodes to flatten\n");
+            ok = false;
+            break;
+        }
+        ok = reserve((void**)&tree->nodes, &treeCapacity, tree->count + 1, sizeof(FlatNode))
+            && reserve((void**)&finished, &finishedCapacity, finishedCount + 1, sizeof(uint32_t));
+        if(!ok) break;
+        FlatNode* node = &tree->nodes[tree->count];
+        node->line = 0;
+        switch(expr->type){
+            case EXPR_LITERAL:
+                node->kind = FLAT_LITERAL;
+                node->as.value = expr->expression.literal.value;
+                if(++depth > tree->maxStack) tree->maxStack = depth;
+                break;
+            case EXPR_GROUPING:
+                node->kind = FLAT_GROUPING;
+                node->as.children.left = finished[--finishedCount];
+                node->as.children.right = 0;
+                break;
+            case EXPR_UNARY:
+                ok = operatorKind(expr, &node->kind);
+                node->line = (uint32_t)expr->expression.unary.oper.line;
+                node->as.children.left = finished[--finishedCount];
+                node->as.children.right = 0;
+                break;
+            case EXPR_BINARY:
+                ok = operatorKind(expr, &node->kind);
+                node->line = (uint32_t)expr->expression.binary.oper.line;
+                node->as.children.right = finished[--finishedCount];
+                node->as.children.left = finished[--finishedCount];
+                depth--;
+                break;
+        }
+        if(!ok){
+            fprintf(errorStream(), "[line %u] Cannot flatten unknown operator\n", node->line);
+            break;
+        }
+        finished[finishedCount++] = tree->count++;
+    }
+
+    tree->capacity = (uint32_t)treeCapacity;
+    free(pending);
+    free(finished);
+    if(!ok) tree->count = 0;
+    return ok;
+}
+
+bool cloneFlatTree(FlatTree* copy, const FlatTree* tree){
+    initFlatTree(copy);
+    if(tree->count == 0) return true;
+    copy->nodes = (FlatNode*)malloc(sizeof(FlatNode) * tree->count);
+    if(!copy->nodes){
+        fprintf(stderr, "Failure to allocate memory for flat tree");
+        return false;
+    }
+    memcpy(copy->nodes, tree->nodes, sizeof(FlatNode) * tree->count);
+    copy->count = tree->count;
+    copy->capacity = tree->count;
+    copy->maxStack = tree->maxStack;
+    return true;
+}
+
+InterpretResult evaluateFlatTree(const FlatTree* tree, InternTable* strings, Value* result){
+    Value* stack = (Value*)malloc(sizeof(Value) * (tree->maxStack + 1));
+    if(!stack){
+        fprintf(stderr, "Failure to allocate memory for flat tree evaluation");
+        return INTERPRET_RUNTIME_ERROR;
+    }
+    // children come first, so a single pass sees every operand before its operator
+    Value* stackTop = stack;
+    const FlatNode* node = tree->nodes;
+    const FlatNode* end = tree->nodes + tree->count;
+
+#define POP() (*--stackTop)
+#define PEEK() (stackTop[-1])
+#define RUNTIME_ERROR(message) \
+    do{ \
+        fprintf(errorStream(), "[line %u] Runtime error: %s\n", node->line, message); \
+        free(stack); \
+        return INTERPRET_RUNTIME_ERROR; \
+    }while(0)
+// replaces the top two values with the operation's result
+#define BINARY_OP(operation) \
+    do{ \
+        Value b = POP(); \
+        ArithResult status = operation(PEEK(), b, &PEEK()); \
+        if(status != ARITH_OK) RUNTIME_ERROR(arithMessage(status)); \
+    }while(0)
+
+    for(; node < end; node++){
+        switch((FlatKind)node->kind){
+            case FLAT_LITERAL:
+                *stackTop++ = node->as.value;
+                break;
+            case FLAT_GROUPING:
+                break;
+            case FLAT_NEGATE: {
+                ArithResult status = negateValue(PEEK(), &PEEK());
+                if(status != ARITH_OK) RUNTIME_ERROR(arithMessage(status));
+                break;
+            }
+            case FLAT_NOT:
+                PEEK() = BOOL_VAL(isFalsey(PEEK()));
+                break;
+            case FLAT_ADD: {
+                Value b = POP();
+                ArithResult status = addValues(strings, PEEK(), b, &PEEK());
+                if(status != ARITH_OK) RUNTIME_ERROR(arithMessage(status));
+                break;
+            }
+            case FLAT_SUBTRACT:
+                BINARY_OP(subtractValues);
+                break;
+            case FLAT_MULTIPLY:
+                BINARY_OP(multiplyValues);
+                break;
+            case FLAT_DIVIDE:
+                BINARY_OP(divideValues);
+                break;
+            case FLAT_EQUAL: {
+                Value b = POP();
+                PEEK() = BOOL_VAL(valuesEqual(PEEK(), b));
+                break;
+            }
+            case FLAT_NOT_EQUAL: {
+                Value b = POP();
+                PEEK() = BOOL_VAL(!valuesEqual(PEEK(), b));
+                break;
+            }
+            case FLAT_GREATER:
+                BINARY_OP(greaterValues);
+                break;
+            case FLAT_GREATER_EQUAL:
+                BINARY_OP(greaterEqualValues);
+                break;
+            case FLAT_LESS:
+                BINARY_OP(lessValues);
+                break;
+            case FLAT_LESS_EQUAL:
+                BINARY_OP(lessEqualValues);
+                break;
+        }
+    }
+    *result = stackTop > stack ? POP() : NIL_VAL;
+    free(stack);
+    return INTERPRET_OK;
+
+#undef POP
+#undef PEEK
+#undef RUNTIME_ERROR
+#undef BINARY_OP
+}
@@ -0,0 +1,67 @@
+#ifndef FLAT_H
+#define FLAT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../expression/expression.h"
+#include "../intern/intern.h"
+#include "../vm/vm.h"
+
+// An expression tree as one array of 16-byte nodes in postorder: children
+// come before their parent and the root is last. Nodes refer to children
+// by index, so a tree can be copied with memcpy, and every walk over it is
+// a loop instead of recursion. Once built a tree is never written, so
+// threads can share one as long as the intern table holding its string
+// literals outlives them.
+typedef enum{
+    FLAT_LITERAL,
+    FLAT_GROUPING,
+    FLAT_NEGATE,
+    FLAT_NOT,
+    FLAT_ADD,
+    FLAT_SUBTRACT,
+    FLAT_MULTIPLY,
+    FLAT_DIVIDE,
+    FLAT_EQUAL,
+    FLAT_NOT_EQUAL,
+    FLAT_GREATER,
+    FLAT_GREATER_EQUAL,
+    FLAT_LESS,
+    FLAT_LESS_EQUAL
+} FlatKind;
+
+typedef struct{
+    uint8_t kind;
+    // of the operator, for runtime errors
+    uint32_t line;
+    union{
+        // unary and grouping nodes use left only
+        struct{
+            uint32_t left;
+            uint32_t right;
+        } children;
+        Value value;
+    } as;
+} FlatNode;
+
+// indices leave the top bit free for walks to mark nodes with
+#define FLAT_MAX_NODES INT32_MAX
+
+typedef struct{
+    FlatNode* nodes;
+    uint32_t count;
+    uint32_t capacity;
+    // deepest the value stack gets while evaluating
+    uint32_t maxStack;
+} FlatTree;
+
+void initFlatTree(FlatTree* tree);
+void freeFlatTree(FlatTree* tree);
+// fails on trees with missing operands, which only parse errors leave
+bool flattenExpr(FlatTree* tree, Expr* root);
+bool cloneFlatTree(FlatTree* copy, const FlatTree* tree);
+// Evaluates the tree in one pass over the array, with the VM's semantics
+// and runtime errors; runtime strings are interned in strings.
+InterpretResult evaluateFlatTree(const FlatTree* tree, InternTable* strings, Value* result);
+
+#endif
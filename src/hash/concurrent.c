@@ -0,0 +1,341 @@
+#include "concurrent.h"
+#include "hashtable.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+
+// must be at least CONCURRENT_STRIPES so a bucket never spans two stripes
+#define INITIAL_CAPACITY 64
+#define MAX_LOAD(capacity) ((capacity) / 4 * 3)
+// old buckets each writer moves while a resize is in progress
+#define MIGRATE_BATCH 8
+// retired objects that trigger a reclamation pass
+#define RECLAIM_THRESHOLD 1024
+// every array's capacity is a multiple of the stripe count, so all keys
+// of a bucket, in the old array and in the new one, share a stripe
+#define STRIPE(hash) ((size_t)(hash) & (CONCURRENT_STRIPES - 1))
+#define BUCKET(hash, capacity) ((size_t)(hash) & ((capacity) - 1))
+
+static _Atomic size_t nextReaderShard;
+static _Thread_local size_t readerShard = SIZE_MAX;
+
+static ConcurrentNode* newNode(const char* key, size_t length, uint64_t hashValue, void* val){
+    ConcurrentNode* node = (ConcurrentNode*)malloc(sizeof(ConcurrentNode) + length + 1);
+    if(!node){
+        // a half-applied update would break the table for every thread
+        fprintf(stderr, "Failed to allocate memory for concurrent table node\n");
+        abort();
+    }
+    atomic_init(&node->next, NULL);
+    atomic_init(&node->value, val);
+    node->retiredNext = NULL;
+    node->hash = hashValue;
+    node->length = length;
+    memcpy(node->key, key, length);
+    node->key[length] = '\0';
+    return node;
+}
+
+static ConcurrentBuckets* newBuckets(size_t capacity, ConcurrentBuckets* old){
+    ConcurrentBuckets* buckets = (ConcurrentBuckets*)malloc(sizeof(ConcurrentBuckets) + sizeof(_Atomic(ConcurrentNode*)) * capacity);
+    if(!buckets){
+        fprintf(stderr, "Failed to allocate memory for concurrent table buckets\n");
+        abort();
+    }
+    buckets->capacity = capacity;
+    buckets->migrated = NULL;
+    buckets->retiredNext = NULL;
+    atomic_init(&buckets->old, old);
+    atomic_init(&buckets->migrateCursor, 0);
+    atomic_init(&buckets->migratedCount, 0);
+    for(size_t i = 0; i < capacity; i++){
+        atomic_init(&buckets->heads[i], NULL);
+    }
+    if(old){
+        buckets->migrated = (_Atomic(bool)*)malloc(sizeof(_Atomic(bool)) * old->capacity);
+        if(!buckets->migrated){
+            fprintf(stderr, "Failed to allocate memory for concurrent table buckets\n");
+            abort();
+        }
+        for(size_t i = 0; i < old->capacity; i++){
+            atomic_init(&buckets->migrated[i], false);
+        }
+    }
+    return buckets;
+}
+
+static void freeBuckets(ConcurrentBuckets* buckets){
+    for(size_t i = 0; i < buckets->capacity; i++){
+        ConcurrentNode* node = atomic_load_explicit(&buckets->heads[i], memory_order_relaxed);
+        while(node){
+            ConcurrentNode* next = atomic_load_explicit(&node->next, memory_order_relaxed);
+            free(node);
+            node = next;
+        }
+    }
+    free(buckets->migrated);
+    free(buckets);
+}
+
+void initConcurrentTable(ConcurrentTable* table){
+    atomic_init(&table->buckets, newBuckets(INITIAL_CAPACITY, NULL));
+    atomic_init(&table->count, 0);
+    for(size_t i = 0; i < CONCURRENT_STRIPES; i++){
+        pthread_mutex_init(&table->stripes[i], NULL);
+    }
+    pthread_mutex_init(&table->resizeLock, NULL);
+    pthread_mutex_init(&table->reclaimLock, NULL);
+    atomic_init(&table->epoch, 0);
+    for(size_t i = 0; i < READER_SHARDS; i++){
+        atomic_init(&table->readers[0][i].count, 0);
+        atomic_init(&table->readers[1][i].count, 0);
+    }
+    atomic_init(&table->retiredNodes, NULL);
+    atomic_init(&table->retiredBuckets, NULL);
+    atomic_init(&table->retiredCount, 0);
+}
+
+// Reclamation: a reader registers under the parity of the current epoch.
+// waitForReaders bumps the epoch and waits for the previous parity to
+// drain; anything unlinked before the bump is then unreachable.
+
+static _Atomic size_t* enterRead(ConcurrentTable* table){
+    if(readerShard == SIZE_MAX){
+        readerShard = atomic_fetch_add(&nextReaderShard, 1) % READER_SHARDS;
+    }
+    for(;;){
+        uint64_t epoch = atomic_load(&table->epoch);
+        _Atomic size_t* counter = &table->readers[epoch & 1][readerShard].count;
+        atomic_fetch_add(counter, 1);
+        if(atomic_load(&table->epoch) == epoch) return counter;
+        atomic_fetch_sub(counter, 1);
+    }
+}
+
+static void exitRead(_Atomic size_t* counter){
+    atomic_fetch_sub_explicit(counter, 1, memory_order_release);
+}
+
+static void waitForReaders(ConcurrentTable* table){
+    uint64_t epoch = atomic_fetch_add(&table->epoch, 1);
+    for(size_t i = 0; i < READER_SHARDS; i++){
+        while(atomic_load(&table->readers[epoch & 1][i].count) != 0){
+            sched_yield();
+        }
+    }
+}
+
+static void retireNode(ConcurrentTable* table, ConcurrentNode* node){
+    ConcurrentNode* head = atomic_load_explicit(&table->retiredNodes, memory_order_relaxed);
+    do{
+        node->retiredNext = head;
+    } while(!atomic_compare_exchange_weak(&table->retiredNodes, &head, node));
+    atomic_fetch_add_explicit(&table->retiredCount, 1, memory_order_relaxed);
+}
+
+static void retireBuckets(ConcurrentTable* table, ConcurrentBuckets* buckets){
+    ConcurrentBuckets* head = atomic_load_explicit(&table->retiredBuckets, memory_order_relaxed);
+    do{
+        buckets->retiredNext = head;
+    } while(!atomic_compare_exchange_weak(&table->retiredBuckets, &head, buckets));
+    atomic_fetch_add_explicit(&table->retiredCount, RECLAIM_THRESHOLD, memory_order_relaxed);
+}
+
+static void freeRetired(ConcurrentNode* nodes, ConcurrentBuckets* buckets){
+    while(nodes){
+        ConcurrentNode* next = nodes->retiredNext;
+        free(nodes);
+        nodes = next;
+    }
+    while(buckets){
+        ConcurrentBuckets* next = buckets->retiredNext;
+        freeBuckets(buckets);
+        buckets = next;
+    }
+}
+
+// must not be called from inside a read section
+static void maybeReclaim(ConcurrentTable* table){
+    if(atomic_load_explicit(&table->retiredCount, memory_order_relaxed) < RECLAIM_THRESHOLD) return;
+    if(pthread_mutex_trylock(&table->reclaimLock) != 0) return;
+    atomic_store_explicit(&table->retiredCount, 0, memory_order_relaxed);
+    ConcurrentNode* nodes = atomic_exchange(&table->retiredNodes, NULL);
+    ConcurrentBuckets* buckets = atomic_exchange(&table->retiredBuckets, NULL);
+    waitForReaders(table);
+    freeRetired(nodes, buckets);
+    pthread_mutex_unlock(&table->reclaimLock);
+}
+
+static ConcurrentNode* findInChain(ConcurrentNode* node, uint64_t hashValue, const char* key, size_t length){
+    for(; node; node = atomic_load_explicit(&node->next, memory_order_acquire)){
+        if(node->hash == hashValue && node->length == length && memcmp(node->key, key, length) == 0){
+            return node;
+        }
+    }
+    return NULL;
+}
+
+// the chain that currently owns the key: the old array's bucket until it
+// has been migrated, the new array's afterwards
+static ConcurrentNode* findNode(ConcurrentTable* table, uint64_t hashValue, const char* key, size_t length){
+    ConcurrentBuckets* buckets = atomic_load_explicit(&table->buckets, memory_order_acquire);
+    ConcurrentBuckets* old = atomic_load_explicit(&buckets->old, memory_order_acquire);
+    if(old){
+        size_t index = BUCKET(hashValue, old->capacity);
+        if(!atomic_load_explicit(&buckets->migrated[index], memory_order_acquire)){
+            return findInChain(atomic_load_explicit(&old->heads[index], memory_order_acquire), hashValue, key, length);
+        }
+    }
+    ConcurrentNode* head = atomic_load_explicit(&buckets->heads[BUCKET(hashValue, buckets->capacity)], memory_order_acquire);
+    return findInChain(head, hashValue, key, length);
+}
+
+// Copies one old bucket into the new array. The caller holds the
+// bucket's stripe lock, so no writer can touch either side meanwhile.
+static void migrateBucket(ConcurrentTable* table, ConcurrentBuckets* buckets, ConcurrentBuckets* old, size_t index){
+    if(atomic_load_explicit(&buckets->migrated[index], memory_order_relaxed)) return;
+    ConcurrentNode* node = atomic_load_explicit(&old->heads[index], memory_order_acquire);
+    for(; node; node = atomic_load_explicit(&node->next, memory_order_acquire)){
+        // the old chain stays intact for readers still walking it
+        ConcurrentNode* copy = newNode(node->key, node->length, node->hash, atomic_load(&node->value));
+        _Atomic(ConcurrentNode*)* head = &buckets->heads[BUCKET(node->hash, buckets->capacity)];
+        atomic_store_explicit(&copy->next, atomic_load_explicit(head, memory_order_relaxed), memory_order_relaxed);
+        atomic_store_explicit(head, copy, memory_order_release);
+    }
+    atomic_store_explicit(&buckets->migrated[index], true, memory_order_release);
+    if(atomic_fetch_add(&buckets->migratedCount, 1) + 1 == old->capacity){
+        atomic_store_explicit(&buckets->old, NULL, memory_order_release);
+        retireBuckets(table, old);
+    }
+}
+
+// takes the key's stripe lock and makes sure its bucket lives in the current array
+static ConcurrentBuckets* beginWrite(ConcurrentTable* table, uint64_t hashValue){
+    pthread_mutex_lock(&table->stripes[STRIPE(hashValue)]);
+    // stable while any stripe is held: publishing a new array takes them all
+    ConcurrentBuckets* buckets = atomic_load_explicit(&table->buckets, memory_order_acquire);
+    ConcurrentBuckets* old = atomic_load_explicit(&buckets->old, memory_order_acquire);
+    if(old){
+        migrateBucket(table, buckets, old, BUCKET(hashValue, old->capacity));
+    }
+    return buckets;
+}
+
+static void endWrite(ConcurrentTable* table, uint64_t hashValue){
+    pthread_mutex_unlock(&table->stripes[STRIPE(hashValue)]);
+}
+
+static void helpMigrate(ConcurrentTable* table, ConcurrentBuckets* buckets){
+    ConcurrentBuckets* old = atomic_load_explicit(&buckets->old, memory_order_acquire);
+    if(!old) return;
+    for(int i = 0; i < MIGRATE_BATCH; i++){
+        size_t index = atomic_fetch_add(&buckets->migrateCursor, 1);
+        if(index >= old->capacity) return;
+        pthread_mutex_lock(&table->stripes[STRIPE(index)]);
+        migrateBucket(table, buckets, old, index);
+        pthread_mutex_unlock(&table->stripes[STRIPE(index)]);
+    }
+}
+
+static void maybeGrow(ConcurrentTable* table){
+    ConcurrentBuckets* buckets = atomic_load(&table->buckets);
+    if(atomic_load(&table->count) <= MAX_LOAD(buckets->capacity) || atomic_load(&buckets->old)) return;
+    if(pthread_mutex_trylock(&table->resizeLock) != 0) return;
+    buckets = atomic_load(&table->buckets);
+    if(atomic_load(&table->count) > MAX_LOAD(buckets->capacity) && !atomic_load(&buckets->old)){
+        ConcurrentBuckets* grown = newBuckets(buckets->capacity * 2, buckets);
+        // writers pause for the swap only; readers carry on throughout
+        for(size_t i = 0; i < CONCURRENT_STRIPES; i++) pthread_mutex_lock(&table->stripes[i]);
+        atomic_store_explicit(&table->buckets, grown, memory_order_release);
+        for(size_t i = 0; i < CONCURRENT_STRIPES; i++) pthread_mutex_unlock(&table->stripes[i]);
+    }
+    pthread_mutex_unlock(&table->resizeLock);
+}
+
+static void* insertEntry(ConcurrentTable* table, const char* key, size_t length, void* val, bool replace){
+    uint64_t hashValue = hash(key, length);
+    _Atomic size_t* reader = enterRead(table);
+    ConcurrentBuckets* buckets = beginWrite(table, hashValue);
+    _Atomic(ConcurrentNode*)* head = &buckets->heads[BUCKET(hashValue, buckets->capacity)];
+    ConcurrentNode* node = findInChain(atomic_load_explicit(head, memory_order_relaxed), hashValue, key, length);
+    void* result = val;
+    if(node){
+        if(replace) atomic_store_explicit(&node->value, val, memory_order_release);
+        else result = atomic_load_explicit(&node->value, memory_order_acquire);
+    }
+    else{
+        node = newNode(key, length, hashValue, val);
+        atomic_store_explicit(&node->next, atomic_load_explicit(head, memory_order_relaxed), memory_order_relaxed);
+        atomic_store_explicit(head, node, memory_order_release);
+        atomic_fetch_add(&table->count, 1);
+    }
+    endWrite(table, hashValue);
+    helpMigrate(table, buckets);
+    maybeGrow(table);
+    exitRead(reader);
+    maybeReclaim(table);
+    return result;
+}
+
+void makeConcurrentEntry(ConcurrentTable* table, const char* key, size_t length, void* val){
+    insertEntry(table, key, length, val, true);
+}
+
+void* makeConcurrentEntryIfAbsent(ConcurrentTable* table, const char* key, size_t length, void* val){
+    return insertEntry(table, key, length, val, false);
+}
+
+void* getConcurrentEntry(ConcurrentTable* table, const char* key, size_t length){
+    uint64_t hashValue = hash(key, length);
+    _Atomic size_t* reader = enterRead(table);
+    ConcurrentNode* node = findNode(table, hashValue, key, length);
+    void* value = node ? atomic_load_explicit(&node->value, memory_order_acquire) : NULL;
+    exitRead(reader);
+    return value;
+}
+
+bool deleteConcurrentEntry(ConcurrentTable* table, const char* key, size_t length){
+    uint64_t hashValue = hash(key, length);
+    _Atomic size_t* reader = enterRead(table);
+    ConcurrentBuckets* buckets = beginWrite(table, hashValue);
+    _Atomic(ConcurrentNode*)* link = &buckets->heads[BUCKET(hashValue, buckets->capacity)];
+    ConcurrentNode* node = atomic_load_explicit(link, memory_order_relaxed);
+    bool found = false;
+    while(node){
+        if(node->hash == hashValue && node->length == length && memcmp(node->key, key, length) == 0){
+            // readers already on the node still follow its next pointer
+            atomic_store_explicit(link, atomic_load_explicit(&node->next, memory_order_relaxed), memory_order_release);
+            retireNode(table, node);
+            atomic_fetch_sub(&table->count, 1);
+            found = true;
+            break;
+        }
+        link = &node->next;
+        node = atomic_load_explicit(link, memory_order_relaxed);
+    }
+    endWrite(table, hashValue);
+    helpMigrate(table, buckets);
+    exitRead(reader);
+    maybeReclaim(table);
+    return found;
+}
+
+size_t concurrentTableCount(ConcurrentTable* table){
+    return atomic_load(&table->count);
+}
+
+// no other thread may use the table once this is called
+void freeConcurrentTable(ConcurrentTable* table){
+    freeRetired(atomic_load(&table->retiredNodes), atomic_load(&table->retiredBuckets));
+    ConcurrentBuckets* buckets = atomic_load(&table->buckets);
+    ConcurrentBuckets* old = atomic_load(&buckets->old);
+    if(old) freeBuckets(old);
+    freeBuckets(buckets);
+    for(size_t i = 0; i < CONCURRENT_STRIPES; i++){
+        pthread_mutex_destroy(&table->stripes[i]);
+    }
+    pthread_mutex_destroy(&table->resizeLock);
+    pthread_mutex_destroy(&table->reclaimLock);
+    atomic_store(&table->buckets, NULL);
+}
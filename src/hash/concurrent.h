@@ -0,0 +1,78 @@
+#ifndef CONCURRENT_H
+#define CONCURRENT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+// A hashtable that many threads can read and write at once.
+//
+// Buckets are chains of nodes. A node's key never changes and its value
+// is swapped atomically, so readers walk chains without taking any lock.
+// Writers lock one of CONCURRENT_STRIPES mutexes chosen by the key's hash.
+// Growing allocates a second bucket array and moves old buckets across a
+// few at a time as writers pass through; readers consult whichever array
+// currently owns the key's bucket and are never blocked.
+//
+// Unlinked nodes and drained arrays are freed only after every reader
+// that could still see them has left (a two-counter epoch scheme).
+#define CONCURRENT_STRIPES 64
+// readers count themselves in one of several padded counters so reads
+// from different threads do not all bounce a single cache line
+#define READER_SHARDS 16
+
+typedef struct ConcurrentNode ConcurrentNode;
+typedef struct ConcurrentBuckets ConcurrentBuckets;
+
+typedef struct ConcurrentNode{
+    _Atomic(ConcurrentNode*) next;
+    ConcurrentNode* retiredNext;
+    _Atomic(void*) value;
+    uint64_t hash;
+    size_t length;
+    char key[];
+} ConcurrentNode;
+
+typedef struct ConcurrentBuckets{
+    size_t capacity;
+    // the array being drained into this one, or NULL
+    _Atomic(ConcurrentBuckets*) old;
+    // one flag per bucket of old, set once that bucket has been moved
+    _Atomic(bool)* migrated;
+    _Atomic size_t migrateCursor;
+    _Atomic size_t migratedCount;
+    ConcurrentBuckets* retiredNext;
+    _Atomic(ConcurrentNode*) heads[];
+} ConcurrentBuckets;
+
+typedef struct{
+    _Atomic size_t count;
+    char padding[64 - sizeof(size_t)];
+} ReaderCounter;
+
+typedef struct{
+    _Atomic(ConcurrentBuckets*) buckets;
+    _Atomic size_t count;
+    pthread_mutex_t stripes[CONCURRENT_STRIPES];
+    pthread_mutex_t resizeLock;
+    // reclamation
+    _Atomic uint64_t epoch;
+    ReaderCounter readers[2][READER_SHARDS];
+    pthread_mutex_t reclaimLock;
+    _Atomic(ConcurrentNode*) retiredNodes;
+    _Atomic(ConcurrentBuckets*) retiredBuckets;
+    _Atomic size_t retiredCount;
+} ConcurrentTable;
+
+void initConcurrentTable(ConcurrentTable* table);
+void freeConcurrentTable(ConcurrentTable* table);
+void makeConcurrentEntry(ConcurrentTable* table, const char* key, size_t length, void* val);
+// inserts val unless the key is present; returns whichever value is in the table
+void* makeConcurrentEntryIfAbsent(ConcurrentTable* table, const char* key, size_t length, void* val);
+void* getConcurrentEntry(ConcurrentTable* table, const char* key, size_t length);
+bool deleteConcurrentEntry(ConcurrentTable* table, const char* key, size_t length);
+size_t concurrentTableCount(ConcurrentTable* table);
+
+#endif
@@ -3,188 +3,357 @@
 #include <stdio.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include "../stats/stats.h"
+#include "../output/output.h"
 
-#define LOAD_FACTOR 0.75
-#define INITIAL_CAPACITY 8
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define INITIAL_CAPACITY 16
 #define GROWTH_FACTOR 2
-#define PROBE_INDEX(index,capacity) (((index)+1)%capacity)
-#define HASH_INDEX(hash,capacity) ((hash)%capacity)
+// the table is kept at most 7/8 full, counting tombstones
+#define MAX_LOAD(capacity) ((capacity) - (capacity) / 8)
+
+#define CTRL_EMPTY ((uint8_t)0x80)
+#define CTRL_DELETED ((uint8_t)0xfe)
+// high bits pick the starting slot, the low 7 bits go in the control byte
+#define H1(hash) ((size_t)((hash) >> 7))
+#define H2(hash) ((uint8_t)((hash) & 0x7f))
+
+// wyhash-style string hash: 8 or 16 bytes per multiply instead of one
+#define SECRET0 UINT64_C(0xa0761d6478bd642f)
+#define SECRET1 UINT64_C(0xe7037ed1a0b428db)
+#define SECRET2 UINT64_C(0x8ebc6af09c88c6e3)
+#define SECRET3 UINT64_C(0x589965cc75374cc3)
+
+static inline void multiply128(uint64_t* a, uint64_t* b){
+#if defined(__SIZEOF_INT128__)
+    __uint128_t product = (__uint128_t)*a * *b;
+    *a = (uint64_t)product;
+    *b = (uint64_t)(product >> 64);
+#else
+    uint64_t aHigh = *a >> 32, aLow = (uint32_t)*a, bHigh = *b >> 32, bLow = (uint32_t)*b;
+    uint64_t highHigh = aHigh * bHigh, highLow = aHigh * bLow, lowHigh = aLow * bHigh, lowLow = aLow * bLow;
+    uint64_t middle = (lowLow >> 32) + (uint32_t)highLow + (uint32_t)lowHigh;
+    *a = (middle << 32) | (uint32_t)lowLow;
+    *b = highHigh + (highLow >> 32) + (lowHigh >> 32) + (middle >> 32);
+#endif
+}
+
+static inline uint64_t mix(uint64_t a, uint64_t b){
+    multiply128(&a, &b);
+    return a ^ b;
+}
+
+static inline uint64_t read64(const uint8_t* p){
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint64_t read32(const uint8_t* p){
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
 
-uint64_t hash(char* key){
-    uint64_t h = 0x100;
-    size_t keyLength = strlen(key);
-    for (size_t i = 0; i < keyLength; i++) {
-        h ^= key[i] & 255;
-        h *= 1111111111111111111;
+uint64_t hash(const char* key, size_t length){
+    const uint8_t* p = (const uint8_t*)key;
+    uint64_t seed = SECRET0 ^ mix(SECRET0 ^ SECRET1, SECRET1);
+    uint64_t a = 0;
+    uint64_t b = 0;
+    if(length <= 16){
+        if(length >= 4){
+            size_t offset = (length >> 3) << 2;
+            a = (read32(p) << 32) | read32(p + offset);
+            b = (read32(p + length - 4) << 32) | read32(p + length - 4 - offset);
+        }
+        else if(length > 0){
+            a = ((uint64_t)p[0] << 16) | ((uint64_t)p[length >> 1] << 8) | p[length - 1];
+        }
+    }
+    else{
+        size_t remaining = length;
+        if(remaining > 48){
+            // three independent lanes keep the multipliers busy
+            uint64_t seed1 = seed;
+            uint64_t seed2 = seed;
+            do{
+                seed = mix(read64(p) ^ SECRET1, read64(p + 8) ^ seed);
+                seed1 = mix(read64(p + 16) ^ SECRET2, read64(p + 24) ^ seed1);
+                seed2 = mix(read64(p + 32) ^ SECRET3, read64(p + 40) ^ seed2);
+                p += 48;
+                remaining -= 48;
+            } while(remaining > 48);
+            seed ^= seed1 ^ seed2;
+        }
+        while(remaining > 16){
+            seed = mix(read64(p) ^ SECRET1, read64(p + 8) ^ seed);
+            p += 16;
+            remaining -= 16;
+        }
+        a = read64(p + remaining - 16);
+        b = read64(p + remaining - 8);
     }
-    return h;
+    a ^= SECRET1;
+    b ^= seed;
+    multiply128(&a, &b);
+    return mix(a ^ SECRET0 ^ length, b ^ SECRET1);
 }
-void initTable(Table* table){
-    table->count=0;
-    table->capacity=INITIAL_CAPACITY;
-    table->buckets=(Entry*)malloc(sizeof(Entry)*table->capacity);
-    if(!table->buckets){
-        fprintf(stderr,"Failure to allocate memory for buckets");
-        return;
+
+// Group matching: one bit per slot of the 16-slot group starting at ctrl.
+
+#if defined(__SSE2__)
+static inline uint32_t matchByte(const uint8_t* ctrl, uint8_t byte){
+    __m128i group = _mm_loadu_si128((const __m128i*)ctrl);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)byte)));
+}
+
+// EMPTY and DELETED are the only control bytes with the high bit set
+static inline uint32_t matchFree(const uint8_t* ctrl){
+    return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)ctrl));
+}
+#else
+static inline uint32_t matchByte(const uint8_t* ctrl, uint8_t byte){
+    uint32_t mask = 0;
+    for(int i = 0; i < GROUP_WIDTH; i++){
+        if(ctrl[i] == byte) mask |= (uint32_t)1 << i;
     }
-    // Initialize all buckets
-    for (size_t i = 0; i < table->capacity; i++) {
-        table->buckets[i].key = NULL;
-        table->buckets[i].value = NULL;
-        table->buckets[i].state = EMPTY;
+    return mask;
+}
+
+static inline uint32_t matchFree(const uint8_t* ctrl){
+    uint32_t mask = 0;
+    for(int i = 0; i < GROUP_WIDTH; i++){
+        if(ctrl[i] & 0x80) mask |= (uint32_t)1 << i;
     }
+    return mask;
 }
+#endif
 
+static inline int lowestBit(uint32_t mask){
+    return __builtin_ctz(mask);
+}
 
-KeyObject* allocateKeyObject(char* key){
-    KeyObject* object = (KeyObject*)malloc(sizeof(KeyObject));
-    if (!object) {
-        fprintf(stderr, "Failed to allocate memory for KeyObject\n");
-        return NULL;
+static inline const char* entryKey(Table* table, Entry* entry){
+    if(table->ownsKeys && entry->length <= INLINE_KEY_SIZE){
+        return entry->key;
     }
-    size_t keyLength = strlen(key)+1;
-    object->key = (char*)malloc(keyLength);
-    if (!object->key) {
-        fprintf(stderr, "Failed to allocate memory for key string\n");
-        free(object);  // Clean up the previously allocated memory
-        return NULL;
+    const char* key;
+    memcpy(&key, entry->key, sizeof(key));
+    return key;
+}
+
+static bool keyEquals(Table* table, Entry* entry, uint64_t hashValue, const char* key, size_t length){
+    if(entry->hash != hashValue || entry->length != length) return false;
+    const char* stored = entryKey(table, entry);
+    // borrowed keys are often the very same interned pointer
+    return stored == key || memcmp(stored, key, length) == 0;
+}
+
+static void setCtrl(Table* table, size_t index, uint8_t byte){
+    table->ctrl[index] = byte;
+    if(index < GROUP_WIDTH){
+        table->ctrl[table->capacity + index] = byte;
     }
-    strcpy(object->key,key);
-    object->hash = hash(key);
-    return object;
 }
-void resizeTable(Table* table){
-    Entry* oldBuckets = table->buckets;
-    size_t oldCapacity = table->capacity;
-    size_t newCapacity = table->capacity * GROWTH_FACTOR;
-    Entry* newBuckets = (Entry*)malloc(sizeof(Entry)*newCapacity);
-    if(!newBuckets){
-        fprintf(stderr,"Failure to reallocate memory for buckets while resizing table");
-        return;
-    }
-    for(size_t i=0;i<newCapacity;i++){
-        newBuckets[i].key=NULL;
-        newBuckets[i].value=NULL;
-        newBuckets[i].state=EMPTY;
-    }
-    table->buckets=newBuckets;
-    table->capacity=newCapacity;
-    size_t oldCount = table->count;
-    size_t oldTombstoneCount = table->tombstoneCount;
+
+static void freeKey(Table* table, Entry* entry){
+    if(table->ownsKeys && entry->length > INLINE_KEY_SIZE){
+        free((void*)entryKey(table, entry));
+    }
+}
+
+// Probes groups in triangular steps, which visits every group once when
+// the capacity is a power of two. Returns the slot holding the key or
+// SIZE_MAX when an EMPTY byte proves it is absent.
+static size_t findSlot(Table* table, const char* key, size_t length, uint64_t hashValue){
+    size_t mask = table->capacity - 1;
+    size_t position = H1(hashValue) & mask;
+    size_t stride = 0;
+    uint8_t tag = H2(hashValue);
+    for(size_t groups = 1;;groups++){
+        const uint8_t* group = table->ctrl + position;
+        uint32_t candidates = matchByte(group, tag);
+        while(candidates){
+            size_t index = (position + lowestBit(candidates)) & mask;
+            if(keyEquals(table, &table->slots[index], hashValue, key, length)){
+                STAT_PROBE(groups);
+                return index;
+            }
+            candidates &= candidates - 1;
+        }
+        if(matchByte(group, CTRL_EMPTY)){
+            STAT_PROBE(groups);
+            return SIZE_MAX;
+        }
+        stride += GROUP_WIDTH;
+        position = (position + stride) & mask;
+    }
+}
+
+// first EMPTY or DELETED slot on the key's probe sequence
+static size_t findFreeSlot(Table* table, uint64_t hashValue){
+    size_t mask = table->capacity - 1;
+    size_t position = H1(hashValue) & mask;
+    size_t stride = 0;
+    for(;;){
+        uint32_t available = matchFree(table->ctrl + position);
+        if(available){
+            return (position + lowestBit(available)) & mask;
+        }
+        stride += GROUP_WIDTH;
+        position = (position + stride) & mask;
+    }
+}
+
+void initTable(Table* table){
+    // storage is allocated on the first insert
+    table->ctrl=NULL;
+    table->slots=NULL;
     table->count=0;
+    table->capacity=0;
     table->tombstoneCount=0;
+    table->ownsKeys=true;
+}
+
+void initBorrowedKeyTable(Table* table){
+    initTable(table);
+    table->ownsKeys=false;
+}
+
+// moves every live entry into fresh arrays of the given capacity, which
+// also drops all tombstones
+static bool rehashTable(Table* table, size_t capacity){
+    size_t ctrlSize = (capacity + GROUP_WIDTH + 7) & ~(size_t)7;
+    STAT_ADD(STAT_RESIZES, 1);
+    STAT_ALLOC(ctrlSize + sizeof(Entry) * capacity);
+    uint8_t* block = (uint8_t*)malloc(ctrlSize + sizeof(Entry) * capacity);
+    if(!block){
+        fprintf(errorStream(), "Failure to reallocate memory for buckets while resizing table\n");
+        return false;
+    }
+    uint8_t* oldCtrl = table->ctrl;
+    Entry* oldSlots = table->slots;
+    size_t oldCapacity = table->capacity;
+    table->ctrl = block;
+    table->slots = (Entry*)(block + ctrlSize);
+    table->capacity = capacity;
+    table->tombstoneCount = 0;
+    memset(table->ctrl, CTRL_EMPTY, capacity + GROUP_WIDTH);
     for(size_t i=0;i<oldCapacity;i++){
-        if(oldBuckets[i].state == OCCUPIED){
-            size_t index = HASH_INDEX(oldBuckets[i].key->hash,newCapacity);
-            while(newBuckets[index].state == OCCUPIED){
-                index = PROBE_INDEX(index,newCapacity);
-            }
-            newBuckets[index]=oldBuckets[i];
-            table->count++;
+        if(!(oldCtrl[i] & 0x80)){
+            size_t index = findFreeSlot(table, oldSlots[i].hash);
+            setCtrl(table, index, oldCtrl[i]);
+            table->slots[index] = oldSlots[i];
         }
     }
-    if(oldCount!=table->count){
-        printf("Actual Entries - %lu\nNew Table count - %lu",((oldCount)/sizeof(int))-((oldTombstoneCount)/sizeof(int)),(table->count)/sizeof(int));
-    }
-    free(oldBuckets);
+    free(oldCtrl);
+    return true;
 }
 
-void makeEntry(Table* table, char* key, void* val){
-    KeyObject* object = allocateKeyObject(key);
-    Entry entry;
-    entry.key = object;
-    entry.value = val;
-    insertEntry(table,entry);
+void resizeTable(Table* table){
+    rehashTable(table, table->capacity ? table->capacity * GROWTH_FACTOR : INITIAL_CAPACITY);
 }
 
-void insertEntry(Table* table, Entry entry){
-    if(table->count+table->tombstoneCount>=table->capacity*LOAD_FACTOR){
-        resizeTable(table);
+static bool insertEntry(Table* table, const char* key, size_t length, uint64_t hashValue, void* val){
+    STAT_ADD(STAT_INSERTS, 1);
+    if(table->capacity){
+        size_t index = findSlot(table, key, length, hashValue);
+        // encounter the same key so update the value
+        if(index != SIZE_MAX){
+            table->slots[index].value = val;
+            return true;
+        }
     }
-    size_t index = HASH_INDEX(entry.key->hash,table->capacity);
-    size_t startIndex = index;
-    size_t tombstoneIndex = SIZE_MAX;
-    do{
-        // ecncounter an empty entry so insert there
-        if(table->buckets[index].state==EMPTY){
-            if(tombstoneIndex!=SIZE_MAX){
-                index=tombstoneIndex;
-                table->tombstoneCount--;
-            }
-            break;
+    if(table->count + table->tombstoneCount + 1 > MAX_LOAD(table->capacity)){
+        // mostly tombstones: clean up in place instead of growing
+        if(table->capacity && table->count + 1 <= MAX_LOAD(table->capacity) / 2){
+            if(!rehashTable(table, table->capacity)) return false;
         }
-        // encounter the first tombstone and keep track
-        if(table->buckets[index].state==TOMBSTONE && tombstoneIndex==SIZE_MAX){
-            tombstoneIndex=index;
+        else{
+            size_t capacity = table->capacity;
+            resizeTable(table);
+            if(table->capacity == capacity) return false;
         }
-        // encounter the same key so update the value
-        if(table->buckets[index].state==OCCUPIED && table->buckets[index].key->hash==entry.key->hash && strcmp(table->buckets[index].key->key,entry.key->key)==0){
-            free(table->buckets[index].key->key);
-            free(table->buckets[index].key);
-            table->buckets[index]=entry;
-            table->buckets[index].state=OCCUPIED;
-            return;
+    }
+    // the key is copied before the slot is touched, so a failed copy leaves
+    // the table as it was
+    const char* stored = key;
+    bool inlineKey = table->ownsKeys && length <= INLINE_KEY_SIZE;
+    if(table->ownsKeys && !inlineKey){
+        STAT_ALLOC(length + 1);
+        char* copy = (char*)malloc(length + 1);
+        if(!copy){
+            fprintf(errorStream(), "Failed to allocate memory for key string\n");
+            return false;
         }
-        index=PROBE_INDEX(index,table->capacity);
-    } while(index!=startIndex);
-    
-    table->buckets[index]=entry;
-    table->buckets[index].state=OCCUPIED;
+        memcpy(copy, key, length);
+        copy[length] = '\0';
+        stored = copy;
+    }
+    size_t index = findFreeSlot(table, hashValue);
+    if(table->ctrl[index] == CTRL_DELETED){
+        table->tombstoneCount--;
+    }
+    Entry* entry = &table->slots[index];
+    entry->hash = hashValue;
+    entry->value = val;
+    entry->length = (uint32_t)length;
+    if(inlineKey) memcpy(entry->key, key, length);
+    else memcpy(entry->key, &stored, sizeof(stored));
+    setCtrl(table, index, H2(hashValue));
     table->count++;
+    return true;
 }
 
-bool deleteEntry(Table* table, char* key){
+bool makeEntry(Table* table, const char* key, size_t length, void* val){
+    return insertEntry(table,key,length,hash(key,length),val);
+}
+
+bool makeEntryWithHash(Table* table, const char* key, size_t length, uint64_t hashValue, void* val){
+    return insertEntry(table,key,length,hashValue,val);
+}
+
+bool deleteEntry(Table* table, const char* key, size_t length){
     if(table->count==0){
         return false;
     }
-    uint64_t hashValue = hash(key);
-    size_t index = HASH_INDEX(hashValue,table->capacity);
-    size_t startIndex = index;
-    do{
-        if(table->buckets[index].state==EMPTY){
-            return false;
-        }
-        if(table->buckets[index].state==OCCUPIED && table->buckets[index].key->hash==hashValue && strcmp(table->buckets[index].key->key,key)==0){
-            free(table->buckets[index].key->key);
-            free(table->buckets[index].key);
-            table->buckets[index].key = NULL;
-            table->buckets[index].value = NULL;
-            table->buckets[index].state=TOMBSTONE;
-            table->tombstoneCount++;
-            table->count--;
-            return true;
-        }
-        index=PROBE_INDEX(index,table->capacity);
-    }while(index!=startIndex);
-    return false;
+    size_t index = findSlot(table, key, length, hash(key,length));
+    if(index == SIZE_MAX){
+        return false;
+    }
+    freeKey(table, &table->slots[index]);
+    setCtrl(table, index, CTRL_DELETED);
+    table->tombstoneCount++;
+    table->count--;
+    return true;
 }
-void *getEntry(Table* table, char* key){
+
+void *getEntry(Table* table, const char* key, size_t length){
+    return getEntryWithHash(table,key,length,hash(key,length));
+}
+
+void *getEntryWithHash(Table* table, const char* key, size_t length, uint64_t hashValue){
+    STAT_ADD(STAT_LOOKUPS, 1);
     if(table->count==0){
         return NULL;
     }
-    uint64_t hashValue = hash(key);
-    size_t index = HASH_INDEX(hashValue,table->capacity);
-    size_t startIndex = index;
-    do{
-        if(table->buckets[index].state==EMPTY){
-            return NULL;
-        }
-        if(table->buckets[index].state==OCCUPIED && table->buckets[index].key->hash==hashValue && strcmp(table->buckets[index].key->key,key)==0){
-            return table->buckets[index].value;
-        }
-        index=PROBE_INDEX(index,table->capacity);
-    }while(index!=startIndex);
-    return NULL;
+    size_t index = findSlot(table, key, length, hashValue);
+    return index == SIZE_MAX ? NULL : table->slots[index].value;
 }
+
 void freeTable(Table* table){
     for(size_t i=0;i<table->capacity;i++){
-        if(table->buckets[i].state==OCCUPIED){
-            free(table->buckets[i].key->key);
-            free(table->buckets[i].key);
+        if(!(table->ctrl[i] & 0x80)){
+            freeKey(table, &table->slots[i]);
         }
     }
-    free(table->buckets);
+    free(table->ctrl);
+    table->ctrl=NULL;
+    table->slots=NULL;
     table->count=0;
     table->capacity=0;
-    table->buckets=NULL;
-}
\ No newline at end of file
+    table->tombstoneCount=0;
+}
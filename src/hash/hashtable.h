@@ -2,45 +2,49 @@
 #define HASHTABLE_H
 
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdbool.h>
 
-typedef enum{
-    EMPTY,
-    OCCUPIED,
-    TOMBSTONE
-} EntryState;
+// Swiss-style open addressing. A control byte per slot holds either
+// EMPTY, DELETED or the low 7 bits of the key's hash; lookups compare a
+// whole group of 16 control bytes at once and only touch slots whose
+// byte matches. The capacity is a power of two, so indexing is a mask.
+#define GROUP_WIDTH 16
+#define INLINE_KEY_SIZE 20
 
+// keys up to INLINE_KEY_SIZE bytes are stored in the slot itself, longer
+// keys (and all keys of a borrowed-key table) are stored as a pointer
 typedef struct{
-    char* key;
     uint64_t hash;
-} KeyObject;
-
-typedef struct{
-    KeyObject* key;
     void* value;
-    EntryState state;
+    uint32_t length;
+    char key[INLINE_KEY_SIZE];
 } Entry;
 
 typedef struct{
-    Entry* buckets;
+    // capacity + GROUP_WIDTH bytes; the tail mirrors the first group so
+    // a group can be loaded at any slot without wrapping
+    uint8_t* ctrl;
+    Entry* slots;
     size_t count;
     size_t capacity;
     size_t tombstoneCount;
+    // false when keys point at caller-owned memory that outlives the table
+    bool ownsKeys;
 } Table;
 
-uint64_t hash(char* key);
-KeyObject* allocateKeyObject(char* key);
-void makeEntry(Table* table, char* key, void* val);
+// keys are (pointer, length) slices and need not be NUL-terminated
+uint64_t hash(const char* key, size_t length);
+// false, with the table unchanged, if memory runs out
+bool makeEntry(Table* table, const char* key, size_t length, void* val);
+bool makeEntryWithHash(Table* table, const char* key, size_t length, uint64_t hashValue, void* val);
 void initTable(Table* table);
+void initBorrowedKeyTable(Table* table);
 void resizeTable(Table* table);
-void insertEntry(Table* table, Entry entry);
-bool deleteEntry(Table* table, char* key);
-void *getEntry(Table* table, char* key);
+bool deleteEntry(Table* table, const char* key, size_t length);
+void *getEntry(Table* table, const char* key, size_t length);
+void *getEntryWithHash(Table* table, const char* key, size_t length, uint64_t hashValue);
 void freeTable(Table* table);
 
-
-
-
-
-#endif
\ No newline at end of file
+#endif
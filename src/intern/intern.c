@@ -0,0 +1,67 @@
+#include "intern.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../stats/stats.h"
+
+// each thread interns separately, as no value crosses threads
+static _Thread_local InternTable threadTable;
+
+void initInternTableState(InternTable* table){
+    initBorrowedKeyTable(&table->strings);
+    initArena(&table->arena);
+}
+
+ObjString* internStringIn(InternTable* table, const char* chars, size_t length){
+    uint64_t hashValue = hash(chars, length);
+    ObjString* string = (ObjString*)getEntryWithHash(&table->strings, chars, length, hashValue);
+    if(string) return string;
+    string = copyStringToArena(&table->arena, chars, length, hashValue);
+    if(!string) return NULL;
+    // a string missing from the index would not be the one later interns
+    // of the same bytes find, and strings compare by pointer; its bytes
+    // stay in the arena until the table is freed
+    if(!makeEntryWithHash(&table->strings, string->chars, length, hashValue, string)) return NULL;
+    return string;
+}
+
+ObjString* internConcatenationIn(InternTable* table, ObjString* a, ObjString* b){
+    size_t length = a->length + b->length;
+    char buffer[256];
+    if(length > sizeof(buffer)) STAT_ALLOC(length);
+    char* chars = length <= sizeof(buffer) ? buffer : (char*)malloc(length);
+    if(!chars){
+        fprintf(stderr, "Failed to allocate memory for string concatenation");
+        return NULL;
+    }
+    memcpy(chars, a->chars, a->length);
+    memcpy(chars + a->length, b->chars, b->length);
+    ObjString* string = internStringIn(table, chars, length);
+    if(chars != buffer) free(chars);
+    return string;
+}
+
+void freeInternTableState(InternTable* table){
+    freeTable(&table->strings);
+    freeArena(&table->arena);
+}
+
+InternTable* currentInternTable(){
+    return &threadTable;
+}
+
+void initInternTable(){
+    initInternTableState(&threadTable);
+}
+
+ObjString* internString(const char* chars, size_t length){
+    return internStringIn(&threadTable, chars, length);
+}
+
+ObjString* internConcatenation(ObjString* a, ObjString* b){
+    return internConcatenationIn(&threadTable, a, b);
+}
+
+void freeInternTable(){
+    freeInternTableState(&threadTable);
+}
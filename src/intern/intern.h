@@ -0,0 +1,32 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+#include "../object/object.h"
+#include "../hash/hashtable.h"
+#include "../memory/arena.h"
+
+// String interning. Every string value is created through an intern
+// table, so each distinct string exists once per table and strings from
+// the same table compare equal exactly when their pointers do. Strings
+// live until their table is freed.
+typedef struct{
+    // borrows each string's chars as its key, so contents are stored once
+    Table strings;
+    Arena arena;
+} InternTable;
+
+void initInternTableState(InternTable* table);
+// NULL if memory runs out
+ObjString* internStringIn(InternTable* table, const char* chars, size_t length);
+ObjString* internConcatenationIn(InternTable* table, ObjString* a, ObjString* b);
+void freeInternTableState(InternTable* table);
+
+// the calling thread's own table, used by the functions below
+InternTable* currentInternTable();
+void initInternTable();
+ObjString* internString(const char* chars, size_t length);
+ObjString* internConcatenation(ObjString* a, ObjString* b);
+void freeInternTable();
+
+#endif
@@ -0,0 +1,112 @@
+#include "lox.h"
+#include <stdlib.h>
+#include <string.h>
+#include "../scanner/scanner.h"
+#include "../parser/parser.h"
+#include "../optimizer/optimizer.h"
+#include "../compiler/compiler.h"
+#include "../vm/vm.h"
+#include "../intern/intern.h"
+#include "../memory/arena.h"
+
+#ifndef LOX_VERSION
+#define LOX_VERSION "dev"
+#endif
+
+struct LoxContext{
+    // the tree of the statement being run
+    Arena arena;
+    // strings outlive a call so results can be compared across calls
+    InternTable strings;
+    FILE* output;
+    FILE* errors;
+};
+
+LoxContext* loxNewContext(){
+    LoxContext* context = (LoxContext*)malloc(sizeof(LoxContext));
+    if(!context){
+        fprintf(stderr, "Failed to allocate memory for context\n");
+        return NULL;
+    }
+    initArena(&context->arena);
+    initInternTableState(&context->strings);
+    context->output = NULL;
+    context->errors = NULL;
+    return context;
+}
+
+void loxFreeContext(LoxContext* context){
+    if(!context) return;
+    freeInternTableState(&context->strings);
+    freeArena(&context->arena);
+    free(context);
+}
+
+void loxSetOutput(LoxContext* context, FILE* output, FILE* errors){
+    context->output = output;
+    context->errors = errors;
+}
+
+static LoxResult evaluate(LoxContext* context, Expr* expr, FILE* output, FILE* errors){
+    Chunk chunk;
+    initChunk(&chunk);
+    LoxResult result = LOX_COMPILE_ERROR;
+    if(compile(expr, &chunk, errors)){
+        VM vm;
+        initVM(&vm);
+        vm.strings = &context->strings;
+        vm.errorOutput = errors;
+        Value value;
+        result = LOX_RUNTIME_ERROR;
+        if(runChunk(&vm, &chunk, &value) == INTERPRET_OK){
+            displayValueTo(output, value);
+            fputc('\n', output);
+            result = LOX_OK;
+        }
+        freeVM(&vm);
+    }
+    freeChunk(&chunk);
+    return result;
+}
+
+LoxResult loxInterpret(LoxContext* context, const char* source, size_t length){
+    // each stage writes to the context's streams, leaving the calling
+    // thread's own redirection alone
+    FILE* output = context->output ? context->output : stdout;
+    FILE* errors = context->errors ? context->errors : stderr;
+
+    // the scanner relies on a terminating NUL, and tokens point into this
+    // copy, which outlives the arena resets between statements
+    char* copy = (char*)malloc(length + 1);
+    if(!copy){
+        fprintf(errors, "Failed to allocate memory for source\n");
+        return LOX_OUT_OF_MEMORY;
+    }
+    memcpy(copy, source, length);
+    copy[length] = '\0';
+
+    Scanner scanner;
+    Parser parser;
+    initScannerState(&scanner, copy, length);
+    scanner.errorOutput = errors;
+    initParserState(&parser, &scanner, NULL, &context->arena, &context->strings);
+    parser.errorOutput = errors;
+    LoxResult result = LOX_OK;
+    Expr* statement;
+    while(parseStatement(&parser, &statement)){
+        // after a failure the rest is only parsed, to report its syntax errors
+        if(result == LOX_OK){
+            if(!statement || parser.hadError || scanner.hadError) result = LOX_SYNTAX_ERROR;
+            else result = evaluate(context, optimizeWith(statement, &context->strings), output, errors);
+        }
+        resetArena(&context->arena);
+    }
+
+    resetArena(&context->arena);
+    free(copy);
+    return result;
+}
+
+const char* loxVersion(){
+    return LOX_VERSION;
+}
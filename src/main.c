@@ -3,69 +3,291 @@
 #include <string.h>
 #include <limits.h>
 #include <stdbool.h>
+#include <unistd.h>
+#include <pthread.h>
 #include "scanner/scanner.h"
 #include "expression/expression.h"
 #include "printer/printer.h"
 #include "parser/parser.h"
+#include "memory/arena.h"
+#include "chunk/chunk.h"
+#include "compiler/compiler.h"
+#include "vm/vm.h"
+#include "optimizer/optimizer.h"
+#include "intern/intern.h"
+#include "source/source.h"
+#include "output/output.h"
+#include "pool/pool.h"
+#include "cache/cache.h"
+#include "stats/stats.h"
+#include "flat/flat.h"
 
+typedef enum{
+    MODE_PRINT,     // dump tokens and the expression tree
+    MODE_VM,        // compile to bytecode and evaluate
+    MODE_FLAT       // flatten the tree and evaluate it in one pass
+} RunMode;
 
-static void runFile(char* path);
+static void runFile(Arena* arena, const char* path);
 
 static void runPrompt();
 
-static void run(char* source);
+static void runBatch(char** paths, size_t count, int jobs);
+
+static char** readManifest(const char* path, size_t* count);
+
+static void run(Arena* arena, const char* source, size_t length, bool cacheable);
+
+static bool parseFormat(const char* name, DumpFormat* format);
+
+static void runSource(Arena* arena, const char* source, size_t length, bool cacheable);
+
+static void runCached(Arena* arena, CachedProgram* program);
+
+static bool runStatement(Expr* statement);
+
+static void printTokens(TokenList* list);
+
+static void printTree(Expr* expression);
+
+static Expr* optimizeTree(Expr* expression);
+
+static bool evaluate(Expr* expression);
+
+// owns every Expr node of the current run; batch workers have their own
+static Arena arena;
+static RunMode mode = MODE_PRINT;
+// print the tree before and after the optimizer runs
+static bool dumpOptimization = false;
+// debug dumps; print mode turns both on unless told otherwise (-1)
+static int dumpTokens = -1;
+static int dumpTree = -1;
+static DumpFormat dumpFormat = DUMP_SEXPR;
+// per-phase timings and counters after every run (--stats[=json])
+static bool showStats = false;
+static bool statsJson = false;
+// parsed programs of script files are reused across runs (--cache)
+static AstCache cache;
+static bool useCache = false;
 
 int main(int argc, char* argv[]){
-    if(argc>2){
-        fprintf(stderr,"Usage: lox [script]");
-        exit(EXIT_FAILURE);
+    int argi = 1;
+    int jobs = 0;
+    const char* manifest = NULL;
+    for(; argi<argc && strncmp(argv[argi],"--",2)==0; argi++){
+        if(strcmp(argv[argi],"--vm")==0){
+            mode = MODE_VM;
+        }
+        else if(strcmp(argv[argi],"--flat")==0){
+            mode = MODE_FLAT;
+        }
+        else if(strcmp(argv[argi],"--dump-opt")==0){
+            dumpOptimization = true;
+        }
+        else if(strcmp(argv[argi],"--jobs")==0 && argi+1<argc && atoi(argv[argi+1])>0){
+            jobs = atoi(argv[++argi]);
+        }
+        else if(strcmp(argv[argi],"--manifest")==0 && argi+1<argc){
+            manifest = argv[++argi];
+        }
+        else if(strcmp(argv[argi],"--cache")==0){
+            useCache = initAstCache(&cache, NULL);
+        }
+        else if(strcmp(argv[argi],"--tokens")==0 || strcmp(argv[argi],"--no-tokens")==0){
+            dumpTokens = argv[argi][2] != 'n';
+        }
+        else if(strcmp(argv[argi],"--ast")==0 || strcmp(argv[argi],"--no-ast")==0){
+            dumpTree = argv[argi][2] != 'n';
+        }
+        else if(strcmp(argv[argi],"--stats")==0 || strcmp(argv[argi],"--stats=json")==0){
+#ifndef LOX_STATS
+            fprintf(stderr,"--stats needs a build with -DLOX_STATS=ON\n");
+            exit(EXIT_FAILURE);
+#endif
+            showStats = true;
+            statsTiming = true;
+            statsJson = argv[argi][7] == '=';
+        }
+        else if(strcmp(argv[argi],"--format")==0 && argi+1<argc && parseFormat(argv[argi+1], &dumpFormat)){
+            argi++;
+        }
+        else{
+            fprintf(stderr,"Unknown option \"%s\"\n",argv[argi]);
+            fprintf(stderr,"Usage: lox [--vm | --flat] [--dump-opt] [--[no-]tokens] [--[no-]ast] [--format sexpr|json|binary]\n"
+                           "           [--stats[=json]] [--jobs n] [--manifest file] [--cache] [script...]\n");
+            exit(EXIT_FAILURE);
+        }
     }
-    else if (argc == 2)
-    {
-        // gets the absolute path of the file
-        char* absolute_path = realpath(argv[1],NULL);
-        if(!absolute_path){
-            fprintf(stderr,"Could not find the absolute path \"%s\"",absolute_path);
+    if(dumpTokens < 0) dumpTokens = mode == MODE_PRINT;
+    if(dumpTree < 0) dumpTree = mode == MODE_PRINT;
+    // several scripts, or a manifest listing them, run as one batch
+    if(manifest || argc-argi>1){
+        size_t count = (size_t)(argc-argi);
+        char** paths = argv+argi;
+        if(manifest){
+            if(argc-argi>0){
+                fprintf(stderr,"Usage: lox [--vm | --flat] [--dump-opt] [--jobs n] --manifest file\n");
+                exit(EXIT_FAILURE);
+            }
+            paths = readManifest(manifest, &count);
+            if(!paths) exit(EXIT_FAILURE);
+        }
+        runBatch(paths, count, jobs > 0 ? jobs : (int)sysconf(_SC_NPROCESSORS_ONLN));
+        if(manifest){
+            for(size_t i=0;i<count;i++) free(paths[i]);
+            free(paths);
         }
-        runFile(absolute_path);
+        if(useCache) freeAstCache(&cache);
+        return 0;
+    }
+    initArena(&arena);
+    initInternTable();
+    if (argc-argi == 1)
+    {
+        // gets the absolute path of the file; pipes such as /dev/stdin
+        // have none and are opened as given
+        char* absolute_path = realpath(argv[argi],NULL);
+        runFile(&arena, absolute_path ? absolute_path : argv[argi]);
+        free(absolute_path);
     }
     else {
         runPrompt();
     }
-    
+    freeInternTable();
+    freeArena(&arena);
+    if(useCache) freeAstCache(&cache);
 }
 
 // Implementation of run functions
 
-static void runFile(char* path){
-    FILE* file;
-    file = fopen(path,"rb");
-    if(!file){
-        fprintf(stderr,"Failed to open file at \"%s\"",path);
+static void runFile(Arena* arena, const char* path){
+    Source source;
+    STATS_RESET();
+    STATS_PHASE(PHASE_LOAD);
+    if(!loadSource(path,&source)){
         return;
     }
-    // gets the size of the file for buffer allocation
-    fseek(file,0,SEEK_END);
-    long file_size = ftell(file);
-    rewind(file);
-    char* buffer = (char*)malloc(file_size+1);
+    run(arena, source.data, source.length, true);
+    freeSource(&source);
+}
 
-    if (!buffer){
-        fprintf(stderr, "Failed to allocate memory \"%s\"",path);
-        fclose(file);
-        return;
+// One script of a batch. Its output is collected in memory and printed
+// once every script before it has been printed.
+typedef struct{
+    const char* path;
+    char* output;
+    size_t outputLength;
+    char* errors;
+    size_t errorsLength;
+    bool done;
+} BatchTask;
+
+typedef struct{
+    BatchTask* tasks;
+    size_t count;
+    // one per worker, reset after every script
+    Arena* arenas;
+    pthread_mutex_t printLock;
+    size_t nextToPrint;
+} Batch;
+
+static void runBatchTask(size_t index, int worker, void* context){
+    Batch* batch = (Batch*)context;
+    BatchTask* task = &batch->tasks[index];
+    FILE* output = open_memstream(&task->output, &task->outputLength);
+    FILE* errors = open_memstream(&task->errors, &task->errorsLength);
+    if(output && errors){
+        redirectOutput(output, errors);
+        // scanner, parser and intern state are per thread, so start each script afresh
+        hadError = false;
+        hadParseError = false;
+        initInternTable();
+        fprintf(output, "==> %s <==\n", task->path);
+        runFile(&batch->arenas[worker], task->path);
+        freeInternTable();
+        redirectOutput(NULL, NULL);
+    }
+    else{
+        fprintf(stderr, "Failed to allocate output buffers for \"%s\"\n", task->path);
+    }
+    if(output) fclose(output);
+    if(errors) fclose(errors);
+
+    // whoever finishes the oldest outstanding script prints the run that follows it
+    pthread_mutex_lock(&batch->printLock);
+    task->done = true;
+    while(batch->nextToPrint < batch->count && batch->tasks[batch->nextToPrint].done){
+        BatchTask* ready = &batch->tasks[batch->nextToPrint++];
+        if(ready->output) fwrite(ready->output, 1, ready->outputLength, stdout);
+        if(ready->errors) fwrite(ready->errors, 1, ready->errorsLength, stderr);
+        free(ready->output);
+        free(ready->errors);
+        ready->output = NULL;
+        ready->errors = NULL;
     }
-    size_t bytes_read = fread(buffer,sizeof(char),file_size,file);
-    if(bytes_read!=file_size){
-        fprintf(stderr,"Error reading file into the buffer");
-        fclose(file);
-        free(buffer);
+    pthread_mutex_unlock(&batch->printLock);
+}
+
+static void runBatch(char** paths, size_t count, int jobs){
+    if(jobs < 1) jobs = 1;
+    Batch batch;
+    batch.count = count;
+    batch.nextToPrint = 0;
+    batch.tasks = (BatchTask*)calloc(count ? count : 1, sizeof(BatchTask));
+    batch.arenas = (Arena*)malloc(sizeof(Arena) * (size_t)jobs);
+    if(!batch.tasks || !batch.arenas){
+        fprintf(stderr, "Failed to allocate memory for batch\n");
+        free(batch.tasks);
+        free(batch.arenas);
         return;
     }
-    buffer[bytes_read]='\0';
-    run(buffer);
+    for(size_t i=0;i<count;i++) batch.tasks[i].path = paths[i];
+    for(int i=0;i<jobs;i++) initArena(&batch.arenas[i]);
+    pthread_mutex_init(&batch.printLock, NULL);
+
+    runPool(count, jobs, runBatchTask, &batch);
+
+    pthread_mutex_destroy(&batch.printLock);
+    for(int i=0;i<jobs;i++) freeArena(&batch.arenas[i]);
+    free(batch.arenas);
+    free(batch.tasks);
+}
+
+// one path per line; blank lines and lines starting with # are skipped
+static char** readManifest(const char* path, size_t* count){
+    FILE* file = fopen(path, "r");
+    if(!file){
+        fprintf(stderr, "Failed to open manifest at \"%s\"\n", path);
+        return NULL;
+    }
+    size_t capacity = 64;
+    char** paths = (char**)malloc(sizeof(char*) * capacity);
+    char* line = NULL;
+    size_t lineCapacity = 0;
+    ssize_t length;
+    *count = 0;
+    while(paths && (length = getline(&line, &lineCapacity, file)) >= 0){
+        while(length > 0 && (line[length-1] == '\n' || line[length-1] == '\r')) line[--length] = '\0';
+        if(length == 0 || line[0] == '#') continue;
+        if(*count >= capacity){
+            capacity *= 2;
+            char** grown = (char**)realloc(paths, sizeof(char*) * capacity);
+            if(!grown){
+                for(size_t i=0;i<*count;i++) free(paths[i]);
+                free(paths);
+                paths = NULL;
+                break;
+            }
+            paths = grown;
+        }
+        char* copy = strdup(line);
+        if(!copy) continue;
+        paths[(*count)++] = copy;
+    }
+    free(line);
     fclose(file);
-    free(buffer);
+    if(!paths) fprintf(stderr, "Failed to allocate memory for manifest\n");
+    return paths;
 }
 
 static void runPrompt(){
@@ -76,42 +298,182 @@ static void runPrompt(){
         if(fgets(line,sizeof(line),stdin)==NULL){
             break;
         }
-        run(line);
+        STATS_RESET();
+        run(&arena, line, strlen(line), false);
         hadError=false;
         hadParseError=false;
     }
 }
 
-static void run(char* source){
-    initScanner(source);
-    initKeywordsTable();
-    TokenList list = scanTokens();
+static bool parseFormat(const char* name, DumpFormat* format){
+    if(strcmp(name,"sexpr")==0) *format = DUMP_SEXPR;
+    else if(strcmp(name,"json")==0) *format = DUMP_JSON;
+    else if(strcmp(name,"binary")==0) *format = DUMP_BINARY;
+    else return false;
+    return true;
+}
 
-    printf("--- Tokens ---\n");
-    for(int i=0;i<list.count;i++){
-        Token token = list.tokens[i];
-        printf("Address: %p  Type: %d Token: \"%s\"\n",(void*)&list.tokens[i],token.type,token.lexeme);
+// Programs run one top-level statement at a time, each as soon as it is
+// parsed, and the arena is reset after every statement, so memory holds
+// a single statement's tree however long the program is.
+static void run(Arena* arena, const char* source, size_t length, bool cacheable){
+    // a cached program skips scanning, so there would be no tokens to dump
+    bool cached = mode != MODE_PRINT && useCache && cacheable && !dumpTokens;
+    CachedProgram program;
+    STATS_PHASE(PHASE_PARSE);
+    if(cached && openCachedProgram(&cache, &program, source, length)){
+        runCached(arena, &program);
+        closeCachedProgram(&program);
     }
+    else{
+        runSource(arena, source, length, cached);
+    }
+    STATS_PHASE(PHASE_TEARDOWN);
+    resetArena(arena);
+    if(showStats) reportStats(errorStream(), statsJson);
+}
 
-    // Initialize parser and parse expression
-    printf("\n--- Parsing ---\n");
-    initParser(&list);
-    Expr* expression = parse();
-
-    if (!hadParseError && expression != NULL) {
-        printf("\n--- Expression Result ---\n");
-        printValue(expression);
-        printf("\n");
-        freeExpr(expression); // Clean up the expression
-    } else {
-        printf("Parse failed with errors.\n");
+static void runSource(Arena* arena, const char* source, size_t length, bool cacheable){
+    initScanner(source, length);
+    // the token dump needs the whole list, so parse from it; --stats
+    // does the same to time scanning and parsing apart
+    bool listed = dumpTokens || showStats;
+    TokenList list;
+    if(listed){
+        STATS_PHASE(PHASE_SCAN);
+        // nothing is run from a list that could not be scanned whole
+        if(!scanTokens(&list)) return;
+        if(dumpTokens) printTokens(&list);
+        STATS_PHASE(PHASE_PARSE);
+        initParserFromList(&list, arena);
+    }
+    else{
+        // tokens are scanned on demand as the parser asks for them
+        initParser(arena);
+    }
+    CacheBuilder builder;
+    initCacheBuilder(&builder);
+    bool running = true;
+    Expr* statement;
+    while(parseNext(&statement)){
+        // copied before the optimizer rewrites it in place
+        if(cacheable && statement && !hadParseError) addCachedStatement(&builder, statement, source, length);
+        running = running && runStatement(statement);
+        STATS_PHASE(PHASE_PARSE);
+        resetArena(arena);
+    }
+    if(cacheable && !hadParseError && !hadError) storeCachedProgram(&cache, &builder, source, length);
+    freeCacheBuilder(&builder);
+    if(listed){
+        // the trees copy their tokens, and lexemes point into the source
+        STATS_PHASE(PHASE_TEARDOWN);
+        freeTokenList(&list);
     }
+}
 
+static void runCached(Arena* arena, CachedProgram* program){
+    Expr* statement;
+    while(nextCachedStatement(program, arena, &statement)){
+        if(!runStatement(statement)) break;
+        STATS_PHASE(PHASE_PARSE);
+        resetArena(arena);
+    }
+}
 
-    freeTokenList(&list);
+// Dumps or runs one statement; NULL is one that failed to parse. Returns
+// false once the program has failed, after which the rest is still
+// parsed, so that every syntax error is reported, but no longer run.
+static bool runStatement(Expr* statement){
+    if(mode == MODE_PRINT){
+        if(dumpTree) printTree(statement);
+        if(dumpOptimization && statement) optimizeTree(statement);
+        return true;
+    }
+    if(!statement || hadParseError || hadError) return false;
+    if(dumpTree) printTree(statement);
+    return evaluate(optimizeTree(statement));
+}
 
+// the text format keeps its section headers; json and binary dumps are
+// left bare so they can be fed to other tools
+static void printTokens(TokenList* list){
+    Writer writer;
+    initWriter(&writer, outputStream());
+    if(dumpFormat == DUMP_SEXPR) writeText(&writer, "--- Tokens ---\n");
+    writeTokens(&writer, list, dumpFormat);
+    if(dumpFormat == DUMP_SEXPR) writeText(&writer, "\n--- Parsing ---\n");
+    flushWriter(&writer);
 }
 
+static void printTree(Expr* expression){
+    Writer writer;
+    initWriter(&writer, outputStream());
+    if (expression != NULL) {
+        if(dumpFormat == DUMP_SEXPR) writeText(&writer, "\n--- Expression Result ---\n");
+        FlatTree tree;
+        initFlatTree(&tree);
+        // the flat walker prints the same text without recursing
+        if(mode == MODE_FLAT && dumpFormat == DUMP_SEXPR && flattenExpr(&tree, expression)){
+            writeFlatTree(&writer, &tree);
+        }
+        else{
+            writeTree(&writer, expression, dumpFormat);
+        }
+        freeFlatTree(&tree);
+        if(dumpFormat == DUMP_SEXPR) writeChar(&writer, '\n');
+    } else if(dumpFormat == DUMP_SEXPR) {
+        writeText(&writer, "Parse failed with errors.\n");
+    } else if(dumpFormat == DUMP_JSON) {
+        writeText(&writer, "null\n");
+    }
+    flushWriter(&writer);
+}
 
+static void printOptimization(const char* heading, Expr* expression){
+    Writer writer;
+    initWriter(&writer, outputStream());
+    if(dumpFormat == DUMP_SEXPR) writeText(&writer, heading);
+    writeTree(&writer, expression, dumpFormat);
+    if(dumpFormat == DUMP_SEXPR) writeChar(&writer, '\n');
+    flushWriter(&writer);
+}
 
+static Expr* optimizeTree(Expr* expression){
+    if(dumpOptimization) printOptimization("--- Before Optimization ---\n", expression);
+    STATS_PHASE(PHASE_OPTIMIZE);
+    expression = optimize(expression);
+    if(dumpOptimization) printOptimization("--- After Optimization ---\n", expression);
+    return expression;
+}
 
+static bool evaluate(Expr* expression){
+    STATS_PHASE(PHASE_EVALUATE);
+    bool ok = false;
+    if(mode == MODE_FLAT){
+        FlatTree tree;
+        initFlatTree(&tree);
+        Value result;
+        if(flattenExpr(&tree, expression) && evaluateFlatTree(&tree, currentInternTable(), &result) == INTERPRET_OK){
+            displayValue(result);
+            fprintf(outputStream(), "\n");
+            ok = true;
+        }
+        freeFlatTree(&tree);
+        return ok;
+    }
+    Chunk chunk;
+    initChunk(&chunk);
+    if(compile(expression, &chunk, errorStream())){
+        VM vm;
+        initVM(&vm);
+        Value result;
+        if(runChunk(&vm, &chunk, &result) == INTERPRET_OK){
+            displayValue(result);
+            fprintf(outputStream(), "\n");
+            ok = true;
+        }
+        freeVM(&vm);
+    }
+    freeChunk(&chunk);
+    return ok;
+}
@@ -0,0 +1,71 @@
+#include "arena.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include "../stats/stats.h"
+
+#define ARENA_INITIAL_BLOCK_SIZE (64 * 1024)
+#define ARENA_MAX_BLOCK_SIZE (16 * 1024 * 1024)
+#define ARENA_ALIGNMENT (sizeof(max_align_t))
+#define ALIGN_UP(size) (((size) + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1))
+
+static ArenaBlock* newBlock(size_t capacity, ArenaBlock* next){
+    ArenaBlock* block = (ArenaBlock*)malloc(sizeof(ArenaBlock) + capacity);
+    if(!block){
+        fprintf(stderr, "Failed to allocate memory for arena block");
+        return NULL;
+    }
+    block->next = next;
+    block->capacity = capacity;
+    block->used = 0;
+    return block;
+}
+
+void initArena(Arena* arena){
+    arena->head = NULL;
+    arena->blockSize = ARENA_INITIAL_BLOCK_SIZE;
+}
+
+void* arenaAlloc(Arena* arena, size_t size){
+    size = ALIGN_UP(size);
+    STAT_ALLOC(size);
+    ArenaBlock* block = arena->head;
+    if(!block || block->capacity - block->used < size){
+        // blocks double in size so a large parse needs only a few of them
+        size_t capacity = arena->blockSize;
+        if(arena->head && arena->blockSize < ARENA_MAX_BLOCK_SIZE){
+            arena->blockSize *= 2;
+        }
+        if(capacity < size) capacity = size;
+        block = newBlock(capacity, arena->head);
+        if(!block) return NULL;
+        arena->head = block;
+    }
+    void* memory = (char*)block->data + block->used;
+    block->used += size;
+    return memory;
+}
+
+void resetArena(Arena* arena){
+    // keep the newest (largest) block around for the next parse
+    ArenaBlock* block = arena->head;
+    if(!block) return;
+    ArenaBlock* rest = block->next;
+    while(rest){
+        ArenaBlock* next = rest->next;
+        free(rest);
+        rest = next;
+    }
+    block->next = NULL;
+    block->used = 0;
+}
+
+void freeArena(Arena* arena){
+    ArenaBlock* block = arena->head;
+    while(block){
+        ArenaBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->head = NULL;
+    arena->blockSize = ARENA_INITIAL_BLOCK_SIZE;
+}
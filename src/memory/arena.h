@@ -0,0 +1,27 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// A bump allocator: allocations are carved out of large blocks and are
+// only ever released all at once by resetArena or freeArena.
+typedef struct ArenaBlock ArenaBlock;
+
+typedef struct ArenaBlock{
+    ArenaBlock* next;
+    size_t capacity;
+    size_t used;
+    max_align_t data[];
+} ArenaBlock;
+
+typedef struct{
+    ArenaBlock* head;
+    size_t blockSize;
+} Arena;
+
+void initArena(Arena* arena);
+void* arenaAlloc(Arena* arena, size_t size);
+void resetArena(Arena* arena);
+void freeArena(Arena* arena);
+
+#endif
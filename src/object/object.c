@@ -0,0 +1,17 @@
+#include "object.h"
+#include <stdio.h>
+#include <string.h>
+
+ObjString* copyStringToArena(Arena* arena, const char* chars, size_t length, uint64_t hash){
+    ObjString* string = (ObjString*)arenaAlloc(arena, sizeof(ObjString) + length + 1);
+    if(!string){
+        fprintf(stderr, "Failed to allocate memory for string object");
+        return NULL;
+    }
+    string->obj.type = OBJ_STRING;
+    string->length = length;
+    string->hash = hash;
+    memcpy(string->chars, chars, length);
+    string->chars[length] = '\0';
+    return string;
+}
@@ -0,0 +1,27 @@
+#ifndef OBJECT_H
+#define OBJECT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "../memory/arena.h"
+
+typedef enum ObjType{
+    OBJ_STRING
+} ObjType;
+
+typedef struct Obj{
+    ObjType type;
+} Obj;
+
+// strings are interned, so two ObjStrings with the same contents are the
+// same pointer; the hash is computed once when the string is created
+typedef struct ObjString{
+    Obj obj;
+    size_t length;
+    uint64_t hash;
+    char chars[];
+} ObjString;
+
+ObjString* copyStringToArena(Arena* arena, const char* chars, size_t length, uint64_t hash);
+
+#endif
@@ -0,0 +1,181 @@
+#include "optimizer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include "../intern/intern.h"
+#include "../value/arith.h"
+
+// Whether the expression always produces a boolean. Numeric types are not
+// tracked: without variables, any operand whose numeric type is known is
+// made of constants and has already been folded.
+static bool isBoolean(Expr* expr){
+    while(expr->type == EXPR_GROUPING) expr = expr->expression.grouping.expression;
+    switch(expr->type){
+        case EXPR_LITERAL:
+            return IS_BOOL(expr->expression.literal.value);
+        case EXPR_UNARY:
+            return expr->expression.unary.oper.type == TOKEN_BANG;
+        case EXPR_BINARY:
+            switch(expr->expression.binary.oper.type){
+                case TOKEN_BANG_EQUAL:
+                case TOKEN_EQUAL_EQUAL:
+                case TOKEN_GREATER:
+                case TOKEN_GREATER_EQUAL:
+                case TOKEN_LESS:
+                case TOKEN_LESS_EQUAL:
+                    return true;
+                default:
+                    return false;
+            }
+        default:
+            return false;
+    }
+}
+
+static bool isLiteral(Expr* expr){
+    return expr->type == EXPR_LITERAL;
+}
+
+static Expr* replaceWithLiteral(Expr* expr, Value value){
+    expr->type = EXPR_LITERAL;
+    expr->expression.literal.value = value;
+    return expr;
+}
+
+// the runtime's own operations; false where the VM would report an error
+static bool foldBinary(InternTable* strings, TokenType oper, Value a, Value b, Value* result){
+    switch(oper){
+        case TOKEN_EQUAL_EQUAL:
+            *result = BOOL_VAL(valuesEqual(a, b));
+            return true;
+        case TOKEN_BANG_EQUAL:
+            *result = BOOL_VAL(!valuesEqual(a, b));
+            return true;
+        case TOKEN_PLUS: return addValues(strings, a, b, result) == ARITH_OK;
+        case TOKEN_MINUS: return subtractValues(a, b, result) == ARITH_OK;
+        case TOKEN_STAR: return multiplyValues(a, b, result) == ARITH_OK;
+        case TOKEN_SLASH: return divideValues(a, b, result) == ARITH_OK;
+        case TOKEN_GREATER: return greaterValues(a, b, result) == ARITH_OK;
+        case TOKEN_GREATER_EQUAL: return greaterEqualValues(a, b, result) == ARITH_OK;
+        case TOKEN_LESS: return lessValues(a, b, result) == ARITH_OK;
+        case TOKEN_LESS_EQUAL: return lessEqualValues(a, b, result) == ARITH_OK;
+        default: return false;
+    }
+}
+
+// children are optimized before their parent
+static Expr* optimizeUnary(Expr* expr){
+    UnaryExpr* unary = &expr->expression.unary;
+    Expr* right = unary->right;
+    if(isLiteral(right)){
+        Value value = right->expression.literal.value;
+        if(unary->oper.type == TOKEN_BANG){
+            return replaceWithLiteral(expr, BOOL_VAL(isFalsey(value)));
+        }
+        Value result;
+        if(negateValue(value, &result) == ARITH_OK) return replaceWithLiteral(expr, result);
+        return expr;
+    }
+    // !!x is x when x is already a boolean
+    if(unary->oper.type == TOKEN_BANG && right->type == EXPR_UNARY && right->expression.unary.oper.type == TOKEN_BANG){
+        Expr* inner = right->expression.unary.right;
+        if(isBoolean(inner)) return inner;
+    }
+    return expr;
+}
+
+static Expr* optimizeBinary(Expr* expr, InternTable* strings){
+    BinaryExpr* binary = &expr->expression.binary;
+    Expr* left = binary->left;
+    Expr* right = binary->right;
+    if(isLiteral(left) && isLiteral(right)){
+        Value result;
+        if(foldBinary(strings, binary->oper.type, left->expression.literal.value, right->expression.literal.value, &result)){
+            return replaceWithLiteral(expr, result);
+        }
+    }
+    return expr;
+}
+
+Expr* optimize(Expr* expr){
+    return optimizeWith(expr, currentInternTable());
+}
+
+// A subtree waiting to be optimized, with the pointer its result replaces.
+// It is expanded once its children have been queued ahead of it, so the
+// walk needs no recursion however deep the tree.
+typedef struct{
+    Expr** slot;
+    bool expanded;
+} PendingSlot;
+
+static Expr* optimizeNode(Expr* expr, InternTable* strings){
+    switch(expr->type){
+        case EXPR_GROUPING:
+            // precedence is already encoded in the tree shape
+            return expr->expression.grouping.expression;
+        case EXPR_UNARY:
+            return optimizeUnary(expr);
+        case EXPR_BINARY:
+            return optimizeBinary(expr, strings);
+        case EXPR_LITERAL:
+            return expr;
+    }
+    return expr;
+}
+
+Expr* optimizeWith(Expr* expr, InternTable* strings){
+    if(!expr) return NULL;
+    Expr* root = expr;
+    size_t count = 0;
+    size_t capacity = 64;
+    PendingSlot* pending = (PendingSlot*)malloc(capacity * sizeof(PendingSlot));
+    if(!pending){
+        fprintf(stderr, "Failure to allocate memory for optimizer");
+        return root;
+    }
+    pending[count++] = (PendingSlot){&root, false};
+    while(count > 0){
+        PendingSlot item = pending[--count];
+        Expr* node = *item.slot;
+        if(item.expanded){
+            *item.slot = optimizeNode(node, strings);
+            continue;
+        }
+        if(count + 3 > capacity){
+            PendingSlot* grown = (PendingSlot*)realloc(pending, capacity * 2 * sizeof(PendingSlot));
+            if(!grown){
+                // every rewrite so far stands on its own, so the tree is
+                // still correct, just less optimized
+                fprintf(stderr, "Failure to allocate memory for optimizer");
+                break;
+            }
+            pending = grown;
+            capacity *= 2;
+        }
+        // the left child is popped, and so optimized, first; literals are
+        // already as simple as they get
+        pending[count++] = (PendingSlot){item.slot, true};
+        Expr** children[2] = {NULL, NULL};
+        switch(node->type){
+            case EXPR_BINARY:
+                children[0] = &node->expression.binary.right;
+                children[1] = &node->expression.binary.left;
+                break;
+            case EXPR_UNARY:
+                children[0] = &node->expression.unary.right;
+                break;
+            case EXPR_GROUPING:
+                children[0] = &node->expression.grouping.expression;
+                break;
+            case EXPR_LITERAL:
+                break;
+        }
+        for(int i = 0; i < 2; i++){
+            if(children[i] && (*children[i])->type != EXPR_LITERAL){
+                pending[count++] = (PendingSlot){children[i], false};
+            }
+        }
+    }
+    free(pending);
+    return root;
+}
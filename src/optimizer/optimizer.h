@@ -0,0 +1,15 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "../expression/expression.h"
+#include "../intern/intern.h"
+
+// Folds constant subtrees, drops grouping nodes and applies identities
+// that hold for every value the operand can take. Operations that would
+// fail at runtime are left in place so the error still surfaces.
+// Nodes are rewritten in place; folded strings go into strings.
+Expr* optimizeWith(Expr* expr, InternTable* strings);
+// optimizeWith using the calling thread's intern table
+Expr* optimize(Expr* expr);
+
+#endif
@@ -0,0 +1,17 @@
+#include "output.h"
+
+static _Thread_local FILE* output;
+static _Thread_local FILE* errors;
+
+FILE* outputStream(){
+    return output ? output : stdout;
+}
+
+FILE* errorStream(){
+    return errors ? errors : stderr;
+}
+
+void redirectOutput(FILE* newOutput, FILE* newErrors){
+    output = newOutput;
+    errors = newErrors;
+}
@@ -0,0 +1,14 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stdio.h>
+
+// Where results and diagnostics are written. Both default to stdout and
+// stderr; a thread can point them elsewhere, as batch workers do to
+// collect each script's output separately.
+FILE* outputStream();
+FILE* errorStream();
+// NULL restores the default
+void redirectOutput(FILE* output, FILE* errors);
+
+#endif
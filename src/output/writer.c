@@ -0,0 +1,73 @@
+#include "writer.h"
+#include <string.h>
+
+void initWriter(Writer* writer, FILE* file){
+    writer->file = file;
+    writer->length = 0;
+}
+
+void flushWriter(Writer* writer){
+    if(writer->length > 0){
+        fwrite(writer->buffer, 1, writer->length, writer->file);
+        writer->length = 0;
+    }
+}
+
+void writeBytes(Writer* writer, const void* bytes, size_t length){
+    if(writer->length + length > WRITER_BUFFER_SIZE){
+        flushWriter(writer);
+        // too large to be worth copying
+        if(length > WRITER_BUFFER_SIZE / 2){
+            fwrite(bytes, 1, length, writer->file);
+            return;
+        }
+    }
+    memcpy(writer->buffer + writer->length, bytes, length);
+    writer->length += length;
+}
+
+void writeChar(Writer* writer, char c){
+    if(writer->length == WRITER_BUFFER_SIZE) flushWriter(writer);
+    writer->buffer[writer->length++] = c;
+}
+
+void writeText(Writer* writer, const char* text){
+    writeBytes(writer, text, strlen(text));
+}
+
+void writeInt(Writer* writer, int64_t value){
+    char digits[24];
+    char* end = digits + sizeof(digits);
+    char* p = end;
+    // negated as unsigned so INT64_MIN does not overflow
+    uint64_t magnitude = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+    do{
+        *--p = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    }while(magnitude);
+    if(value < 0) *--p = '-';
+    writeBytes(writer, p, (size_t)(end - p));
+}
+
+void writeFloat(Writer* writer, double value){
+    // DBL_MAX is 309 digits before the point
+    char text[400];
+    int length = snprintf(text, sizeof(text), "%f", value);
+    if(length > 0) writeBytes(writer, text, (size_t)length);
+}
+
+void writeU8(Writer* writer, uint8_t value){
+    writeChar(writer, (char)value);
+}
+
+void writeU32(Writer* writer, uint32_t value){
+    uint8_t bytes[4];
+    for(int i=0;i<4;i++) bytes[i] = (uint8_t)(value >> (8 * i));
+    writeBytes(writer, bytes, sizeof(bytes));
+}
+
+void writeU64(Writer* writer, uint64_t value){
+    uint8_t bytes[8];
+    for(int i=0;i<8;i++) bytes[i] = (uint8_t)(value >> (8 * i));
+    writeBytes(writer, bytes, sizeof(bytes));
+}
@@ -0,0 +1,34 @@
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define WRITER_BUFFER_SIZE 8192
+
+// Buffers output on the stack and hands it to the stream in large blocks,
+// so dumps cost one fwrite per few kilobytes instead of one per node.
+// Nothing is allocated; flushWriter must run before the writer goes away.
+typedef struct{
+    FILE* file;
+    size_t length;
+    char buffer[WRITER_BUFFER_SIZE];
+} Writer;
+
+void initWriter(Writer* writer, FILE* file);
+void flushWriter(Writer* writer);
+
+void writeBytes(Writer* writer, const void* bytes, size_t length);
+void writeChar(Writer* writer, char c);
+void writeText(Writer* writer, const char* text);
+// decimal text
+void writeInt(Writer* writer, int64_t value);
+// "%f", as displayValue prints floats
+void writeFloat(Writer* writer, double value);
+// little-endian binary
+void writeU8(Writer* writer, uint8_t value);
+void writeU32(Writer* writer, uint32_t value);
+void writeU64(Writer* writer, uint64_t value);
+
+#endif
@@ -1,191 +1,397 @@
 #include "parser.h"
+#include "../intern/intern.h"
+#include "../scanner/number.h"
+#include "../output/output.h"
+#include "../stats/stats.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-bool hadParseError = false;
-Parser parser;
-void initParser(TokenList* tokens){
-    parser.tokens = tokens;
-    parser.current = 0;
+_Thread_local bool hadParseError = false;
+_Thread_local Parser parser;
+static void fillWindow(Parser* parser);
+static const char* nextNewline(const char* from, const char* end);
+
+void initParserState(Parser* parser, Scanner* scanner, TokenList* tokens, Arena* arena, InternTable* strings){
+    parser->tokens = tokens;
+    parser->number = 0;
+    if(tokens){
+        // an empty list reads as a lone end of file
+        static const uint8_t endType = TOKEN_EOF;
+        static const uint32_t zero = 0;
+        bool empty = tokens->count == 0;
+        parser->types = empty ? &endType : tokens->types;
+        parser->offsets = empty ? &zero : tokens->offsets;
+        parser->lengths = empty ? &zero : tokens->lengths;
+        size_t last = empty ? 0 : tokens->count - 1;
+        parser->sourceEnd = tokens->source + parser->offsets[last] + parser->lengths[last];
+        parser->lineStart = tokens->source;
+        parser->nextNewline = nextNewline(tokens->source, parser->sourceEnd);
+        parser->line = tokens->firstLine;
+    }
+    parser->scanner = scanner;
+    parser->arena = arena;
+    parser->strings = strings;
+    parser->errorOutput = errorStream();
+    parser->current = 0;
+    parser->scanned = 0;
+    parser->hadError = false;
+    parser->pending = parser->inlinePending;
+    parser->pendingCount = 0;
+    parser->pendingCapacity = PARSER_INLINE_PENDING;
+    fillWindow(parser);
+}
+
+void initParser(Arena* arena){
+    initParserState(&parser, currentScanner(), NULL, arena, currentInternTable());
+}
+
+void initParserFromList(TokenList* tokens, Arena* arena){
+    initParserState(&parser, NULL, tokens, arena, currentInternTable());
 }
 
-static Token previous();
-static Token peek();
-static bool isAtEnd();
-static Token advance();
-static bool match(TokenType type);
-static Token consume(TokenType type, char* message);
-static void report(int line, char* where, const char* lexeme, char* message);
-static void error(Token token, char* message);
-static void synchronize();
-static Expr* expression();
-static Expr* equality();
-static Expr* comparison();
-static Expr* term();
-static Expr* factor();
-static Expr* unary();
-static Expr* primary();
+static Token previous(Parser* parser);
+static Token peek(Parser* parser);
+static TokenType peekType(Parser* parser);
+static bool isAtEnd(Parser* parser);
+static Token advance(Parser* parser);
+static Token consume(Parser* parser, TokenType type, char* message);
+static void report(FILE* stream, int line, char* where, const char* lexeme, size_t length, char* message);
+static void error(Parser* parser, Token token, char* message);
+static void synchronize(Parser* parser);
+static Token tokenAt(Parser* parser, size_t index);
 
+// Binding power of each operator, lowest first. An operand parsed at one
+// level takes in every operator that binds at least as tightly.
+typedef enum{
+    PREC_NONE,
+    PREC_EQUALITY,      // == !=
+    PREC_COMPARISON,    // < > <= >=
+    PREC_TERM,          // + -
+    PREC_FACTOR,        // * /
+    PREC_UNARY          // ! -
+} Precedence;
 
-static Expr* expression(){
-    return equality();
+// Handlers get the index of the token that selected them, which they
+// turn into a Token only if the node keeps it. Operator handlers return
+// their node without its right operand, which is filled in once parsed.
+typedef Expr* (*PrefixFn)(Parser* parser, size_t token);
+typedef Expr* (*InfixFn)(Parser* parser, Expr* left, size_t token);
+
+typedef struct{
+    PrefixFn prefix;
+    InfixFn infix;
+    Precedence precedence;
+    // for prefix operators, the level their operand is parsed at
+    Precedence operand;
+} ParseRule;
+
+static Expr* parsePrecedence(Parser* parser, Precedence precedence);
+static Expr* grouping(Parser* parser, size_t token);
+static Expr* unary(Parser* parser, size_t token);
+static Expr* literal(Parser* parser, size_t token);
+static Expr* number(Parser* parser, size_t token);
+static Expr* string(Parser* parser, size_t token);
+static Expr* binary(Parser* parser, Expr* left, size_t token);
+
+static const ParseRule rules[TOKEN_EOF + 1] = {
+    [TOKEN_LEFT_PAREN]    = {grouping, NULL,   PREC_NONE,     PREC_EQUALITY},
+    [TOKEN_MINUS]         = {unary,    binary, PREC_TERM,     PREC_UNARY},
+    [TOKEN_PLUS]          = {NULL,     binary, PREC_TERM},
+    [TOKEN_SLASH]         = {NULL,     binary, PREC_FACTOR},
+    [TOKEN_STAR]          = {NULL,     binary, PREC_FACTOR},
+    [TOKEN_BANG]          = {unary,    NULL,   PREC_NONE,     PREC_UNARY},
+    [TOKEN_BANG_EQUAL]    = {NULL,     binary, PREC_EQUALITY},
+    [TOKEN_EQUAL_EQUAL]   = {NULL,     binary, PREC_EQUALITY},
+    [TOKEN_GREATER]       = {NULL,     binary, PREC_COMPARISON},
+    [TOKEN_GREATER_EQUAL] = {NULL,     binary, PREC_COMPARISON},
+    [TOKEN_LESS]          = {NULL,     binary, PREC_COMPARISON},
+    [TOKEN_LESS_EQUAL]    = {NULL,     binary, PREC_COMPARISON},
+    [TOKEN_STRING]        = {string,   NULL,   PREC_NONE},
+    [TOKEN_NUMBER]        = {number,   NULL,   PREC_NONE},
+    [TOKEN_FALSE]         = {literal,  NULL,   PREC_NONE},
+    [TOKEN_TRUE]          = {literal,  NULL,   PREC_NONE},
+    [TOKEN_NIL]           = {literal,  NULL,   PREC_NONE},
+};
+
+
+Expr* parseExpression(Parser* parser){
+    return parsePrecedence(parser, PREC_EQUALITY);
 }
 
 Expr* parse(){
-    return expression();
+    Expr* expr = parseExpression(&parser);
+    if(parser.hadError) hadParseError = true;
+    if(parser.scanner && parser.scanner->hadError) hadError = true;
+    return expr;
 }
 
-static Expr* equality(){
-    Expr* expr = comparison();
-    while(match(TOKEN_BANG_EQUAL) || match(TOKEN_EQUAL_EQUAL)){
-        Token operator = previous();
-        Expr* right = comparison();
-        expr = newBinaryExpr(expr, operator, right);
+// Statements so far are expressions ended by ';'. The last one may leave
+// it out, so a lone expression is still a whole program. A statement that
+// runs on past where its ';' should be is skipped up to the next likely
+// statement start, and only its first error is reported.
+bool parseStatement(Parser* parser, Expr** statement){
+    *statement = NULL;
+    if(isAtEnd(parser)) return false;
+    bool hadEarlierError = parser->hadError;
+    parser->hadError = false;
+    Expr* expr = parseExpression(parser);
+    if(peekType(parser) == TOKEN_SEMICOLON){
+        advance(parser);
     }
-    return expr;
+    else if(!isAtEnd(parser)){
+        if(!parser->hadError) error(parser, peek(parser), "Expect ';' after expression.");
+        synchronize(parser);
+    }
+    if(!parser->hadError) *statement = expr;
+    parser->hadError = parser->hadError || hadEarlierError;
+    return true;
 }
 
-static Expr* comparison(){
-    Expr* expr = term();
-    while(match(TOKEN_GREATER) || match(TOKEN_GREATER_EQUAL) || match(TOKEN_LESS) || match(TOKEN_LESS_EQUAL)){
-        Token operator = previous();
-        Expr* right = term();
-        expr = newBinaryExpr(expr, operator, right);
-    }
-    return expr;
+bool parseNext(Expr** statement){
+    bool more = parseStatement(&parser, statement);
+    if(parser.hadError) hadParseError = true;
+    if(parser.scanner && parser.scanner->hadError) hadError = true;
+    return more;
 }
 
-static Expr* term(){
-    Expr* expr = factor();
-    while(match(TOKEN_MINUS) || match(TOKEN_PLUS)){
-        Token operator = previous();
-        Expr* right = factor();
-        expr = newBinaryExpr(expr, operator, right);
+// grows the pending stack onto the heap, reporting when memory runs out
+static bool reservePending(Parser* parser){
+    if(parser->pendingCount < parser->pendingCapacity) return true;
+    size_t capacity = parser->pendingCapacity * 2;
+    bool inlined = parser->pending == parser->inlinePending;
+    STAT_ALLOC(capacity * sizeof(PendingOperator));
+    PendingOperator* pending = (PendingOperator*)realloc(inlined ? NULL : parser->pending, capacity * sizeof(PendingOperator));
+    if(!pending){
+        error(parser, peek(parser), "Expression nested too deeply.");
+        return false;
     }
-    return expr;
+    if(inlined) memcpy(pending, parser->inlinePending, sizeof(parser->inlinePending));
+    parser->pending = pending;
+    parser->pendingCapacity = capacity;
+    return true;
 }
 
-static Expr* factor(){
-    Expr* expr = unary();
-    while(match(TOKEN_SLASH) || match(TOKEN_STAR)){
-        Token operator = previous();
-        Expr* right = unary();
-        expr = newBinaryExpr(expr, operator, right);
+static void releasePending(Parser* parser){
+    if(parser->pending != parser->inlinePending) free(parser->pending);
+    parser->pending = parser->inlinePending;
+    parser->pendingCount = 0;
+    parser->pendingCapacity = PARSER_INLINE_PENDING;
+}
+
+// attaches a finished operand to the operator waiting for it
+static Expr* completeOperator(Parser* parser, PendingOperator pending, Expr* operand){
+    if(pending.grouping) consume(parser, TOKEN_RIGHT_PAREN, "Expect ')' after expression.");
+    Expr* node = pending.node;
+    if(!node) return NULL;
+    switch(node->type){
+        case EXPR_BINARY: node->expression.binary.right = operand; break;
+        case EXPR_UNARY: node->expression.unary.right = operand; break;
+        case EXPR_GROUPING: node->expression.grouping.expression = operand; break;
+        case EXPR_LITERAL: break;
     }
-    return expr;
+    return node;
 }
 
-static Expr* unary(){
-    while(match(TOKEN_BANG) || match(TOKEN_MINUS)){
-        Token operator = previous();
-        Expr* right = unary();
-        return newUnaryExpr(operator, right);
-    }
-    return primary();
-}
-
-static Expr* primary(){
-    if(match(TOKEN_FALSE)){
-        LiteralValue value;
-        value.boolean = false;
-        return newLiteralExpr(value, LITERAL_BOOLEAN);
-    } 
-    if(match(TOKEN_TRUE)){
-        LiteralValue value;
-        value.boolean = true;
-        return newLiteralExpr(value, LITERAL_BOOLEAN);
-    }
-    if(match(TOKEN_NIL)){
-        LiteralValue value;
-        value.nil = NULL;
-        return newLiteralExpr(value, LITERAL_NIL);  
-    }
-    if(match(TOKEN_NUMBER)){
-        Token token = previous();
-        LiteralValue value;
-        if(strchr(token.lexeme, '.')){
-            value.number.floating = atof(token.lexeme);
-            return newLiteralExpr(value, LITERAL_FLOAT);
+// Pratt parsing with the operators still waiting for an operand on the
+// parser's stack in place of recursive calls: an entry is pushed where
+// the recursive parser would call itself and popped where it would
+// return. A missing operand is reported but does not end the expression:
+// the operators after it are still parsed, as the old level-per-function
+// parser did, so the same errors come out.
+static Expr* parsePrecedence(Parser* parser, Precedence precedence){
+    size_t base = parser->pendingCount;
+    Expr* expr = NULL;
+    bool wantOperand = true;
+    for(;;){
+        const ParseRule* rule = &rules[peekType(parser)];
+        if(wantOperand){
+            expr = NULL;
+            wantOperand = false;
+            if(rule->prefix){
+                size_t token = parser->current++;
+                fillWindow(parser);
+                expr = rule->prefix(parser, token);
+                if(rule->operand != PREC_NONE){
+                    if(!reservePending(parser)) break;
+                    parser->pending[parser->pendingCount++] = (PendingOperator){
+                        expr, (uint8_t)precedence, rule->prefix == grouping};
+                    precedence = rule->operand;
+                    wantOperand = true;
+                }
+            }
+            else{
+                error(parser, peek(parser), "Expect expression.");
+            }
+            continue;
         }
-        value.number.integer = atoi(token.lexeme);
-        return newLiteralExpr(value, LITERAL_INTEGER);
-    }
-    if(match(TOKEN_STRING)){
-        Token token = previous();
-        LiteralValue value;
-        value.string = strdup(token.lexeme);
-        if (!value.string) {
-            fprintf(stderr, "Failed to allocate memory for string literal\n");
-            return NULL;
+        if(rule->infix && rule->precedence >= precedence){
+            if(!reservePending(parser)) break;
+            size_t token = parser->current++;
+            fillWindow(parser);
+            parser->pending[parser->pendingCount++] = (PendingOperator){
+                rule->infix(parser, expr, token), (uint8_t)precedence, false};
+            // operators are left-associative, so the right operand binds one level tighter
+            precedence = rule->precedence + 1;
+            wantOperand = true;
+            continue;
         }
-        return newLiteralExpr(value, LITERAL_STRING);
-    }
-    if(match(TOKEN_LEFT_PAREN)){
-        Expr* expr = expression();
-        consume(TOKEN_RIGHT_PAREN, "Expect ')' after expression.");
-        return newGroupingExpr(expr);
+        if(parser->pendingCount == base){
+            if(base == 0) releasePending(parser);
+            return expr;
+        }
+        PendingOperator pending = parser->pending[--parser->pendingCount];
+        precedence = (Precedence)pending.precedence;
+        expr = completeOperator(parser, pending, expr);
     }
+    // only reached when the stack cannot grow
+    parser->pendingCount = base;
+    if(base == 0) releasePending(parser);
+    return NULL;
+}
 
-    error(peek(), "Expect expression.");
-    return NULL; 
-    
+static Expr* binary(Parser* parser, Expr* left, size_t token){
+    return newBinaryExpr(parser->arena, left, tokenAt(parser, token), NULL);
 }
 
-static Token previous(){
-    return parser.tokens->tokens[parser.current-1];
+static Expr* unary(Parser* parser, size_t token){
+    return newUnaryExpr(parser->arena, tokenAt(parser, token), NULL);
 }
 
-static Token peek(){
-    return parser.tokens->tokens[parser.current];
+static Expr* grouping(Parser* parser, size_t token){
+    (void)token;
+    return newGroupingExpr(parser->arena, NULL);
 }
 
-static bool isAtEnd(){
-    return peek().type == TOKEN_EOF;
+static Expr* literal(Parser* parser, size_t token){
+    switch(tokenAt(parser, token).type){
+        case TOKEN_FALSE: return newLiteralExpr(parser->arena, FALSE_VAL);
+        case TOKEN_TRUE: return newLiteralExpr(parser->arena, TRUE_VAL);
+        default: return newLiteralExpr(parser->arena, NIL_VAL);
+    }
+}
+
+// a listed literal was decoded as it was added; a streamed one is decoded
+// here, just after the scanner read its digits
+static Expr* number(Parser* parser, size_t token){
+    if(parser->tokens){
+        return newLiteralExpr(parser->arena, tokenNumberFrom(parser->tokens, token, &parser->number));
+    }
+    Token literal = tokenAt(parser, token);
+    return newLiteralExpr(parser->arena, decodeNumber(literal.lexeme, literal.length));
+}
+
+static Expr* string(Parser* parser, size_t token){
+    Token string = tokenAt(parser, token);
+    ObjString* interned = internStringIn(parser->strings, string.lexeme, string.length);
+    if (!interned) {
+        return NULL;
+    }
+    return newLiteralExpr(parser->arena, OBJ_VAL(interned));
+}
+
+// pulls tokens until the current one is in the window; a list needs no window
+static void fillWindow(Parser* parser){
+    if(parser->tokens) return;
+    while(parser->scanned <= parser->current){
+        parser->window[parser->scanned & (PARSER_LOOKAHEAD-1)] = scanToken(parser->scanner);
+        STAT_ADD(STAT_TOKENS, 1);
+        parser->scanned++;
+    }
 }
 
-static Token advance(){
-    if(!isAtEnd()) parser.current+=1;
-    return previous();
+// the first newline at or after from, or end when there is none
+static const char* nextNewline(const char* from, const char* end){
+    const char* newline = memchr(from, '\n', (size_t)(end - from));
+    return newline ? newline : end;
 }
 
-static bool match(TokenType type){
-    if(isAtEnd()) return false;
-    if(peek().type==type){
-        advance();
-        return true;
+// Builds a token from the list's columns. Only the tokens the parser keeps
+// or reports are built, and as they come in source order the newlines are
+// found one memchr at a time as tokens pass them, so most tokens cost a
+// single comparison. The line is the scanner's: the one the token ends on.
+static Token listToken(Parser* parser, size_t index){
+    Token token;
+    token.type = (TokenType)parser->types[index];
+    token.lexeme = parser->tokens->source + parser->offsets[index];
+    token.length = parser->lengths[index];
+    const char* end = token.lexeme + token.length;
+    // peek can run ahead of a later previous, so step back first
+    while(end < parser->lineStart){
+        parser->line--;
+        parser->nextNewline = parser->lineStart - 1;
+        const char* start = parser->nextNewline;
+        while(start > parser->tokens->source && start[-1] != '\n') start--;
+        parser->lineStart = start;
+    }
+    while(parser->nextNewline < end){
+        parser->line++;
+        parser->lineStart = parser->nextNewline + 1;
+        parser->nextNewline = nextNewline(parser->lineStart, parser->sourceEnd);
     }
-    return false;
+    token.line = parser->line;
+    return token;
+}
 
+// index must still be in the window when reading from the scanner
+static Token tokenAt(Parser* parser, size_t index){
+    if(parser->tokens) return listToken(parser, index);
+    return parser->window[index & (PARSER_LOOKAHEAD-1)];
+}
+
+static Token previous(Parser* parser){
+    return tokenAt(parser, parser->current-1);
+}
+
+static Token peek(Parser* parser){
+    return tokenAt(parser, parser->current);
+}
+
+// what rule lookups and consume test, read from the list's type column alone
+static TokenType peekType(Parser* parser){
+    if(parser->tokens) return (TokenType)parser->types[parser->current];
+    return parser->window[parser->current & (PARSER_LOOKAHEAD-1)].type;
+}
+
+static bool isAtEnd(Parser* parser){
+    return peekType(parser) == TOKEN_EOF;
+}
+
+static Token advance(Parser* parser){
+    if(!isAtEnd(parser)){
+        parser->current+=1;
+        fillWindow(parser);
+    }
+    return previous(parser);
 }
 
-static Token consume(TokenType type, char* message){
-    if(!isAtEnd() && peek().type==type){
-        return advance();
+static Token consume(Parser* parser, TokenType type, char* message){
+    if(!isAtEnd(parser) && peekType(parser)==type){
+        return advance(parser);
     }
-    error(peek(), message);
-    return peek();
+    error(parser, peek(parser), message);
+    return peek(parser);
 }
 
-static void report(int line, char* where, const char* lexeme, char* message){
+static void report(FILE* stream, int line, char* where, const char* lexeme, size_t length, char* message){
     if (lexeme) {
-        fprintf(stderr, "[line %d] Error%s '%s': %s\n", line, where, lexeme, message);
+        fprintf(stream, "[line %d] Error%s '%.*s': %s\n", line, where, (int)length, lexeme, message);
     } else {
-        fprintf(stderr, "[line %d] Error%s: %s\n", line, where, message);
+        fprintf(stream, "[line %d] Error%s: %s\n", line, where, message);
     }
 }
 
-static void error(Token token, char* message){
-    if(token.type==TOKEN_EOF) report(token.line, " at end",NULL, message);
-    else report(token.line, " at", token.lexeme, message);
-    hadParseError = true;
+static void error(Parser* parser, Token token, char* message){
+    if(token.type==TOKEN_EOF) report(parser->errorOutput, token.line, " at end",NULL, 0, message);
+    else report(parser->errorOutput, token.line, " at", token.lexeme, token.length, message);
+    parser->hadError = true;
 }
 
-static void synchronize(){
-    advance();
-    while(!isAtEnd()){
-        if(previous().type==TOKEN_SEMICOLON) return;
-        switch(peek().type){
+static void synchronize(Parser* parser){
+    advance(parser);
+    while(!isAtEnd(parser)){
+        if(previous(parser).type==TOKEN_SEMICOLON) return;
+        switch(peekType(parser)){
             case TOKEN_CLASS:
             case TOKEN_FUN:
             case TOKEN_VAR:
@@ -195,7 +401,9 @@ static void synchronize(){
             case TOKEN_PRINT:
             case TOKEN_RETURN:
                 return;
+            default:
+                break;
         }
-        advance();
+        advance(parser);
     }
 }
\ No newline at end of file
@@ -3,23 +3,78 @@
 
 #include "../scanner/scanner.h"
 #include "../expression/expression.h"
-extern bool hadParseError;
-typedef struct{
-    TokenList* tokens;
-    int current;
-} Parser;
-
-void initParser(TokenList* tokens);
-Expr* parse();
-void freeParser(Parser* parser);
-
-
-
+#include "../intern/intern.h"
+extern _Thread_local bool hadParseError;
+// Tokens are pulled on demand into a small ring buffer. The parser only
+// ever looks at the current and the previous token, so scanning runs in
+// constant memory alongside parsing.
+#define PARSER_LOOKAHEAD 4
 
+// An operator whose node is built but whose right operand is still being
+// parsed. The parser keeps these on its own stack rather than the call
+// stack, so nesting depth is bounded by memory alone.
+typedef struct{
+    Expr* node;
+    // the level the operator itself was parsed at, restored once it is done
+    uint8_t precedence;
+    // groupings still need their ')'
+    bool grouping;
+} PendingOperator;
 
+// enough for ordinary expressions; deeper ones move to the heap
+#define PARSER_INLINE_PENDING 32
 
+typedef struct{
+    // NULL when tokens are pulled straight from the scanner
+    TokenList* tokens;
+    // the list's columns, copied so reading one token is a single indexed load
+    const uint8_t* types;
+    const uint32_t* offsets;
+    const uint32_t* lengths;
+    // Lines of tokens built from the list are found from the source as
+    // the parser passes them, so no line index is needed: line is the line
+    // that starts at lineStart and ends at nextNewline.
+    const char* lineStart;
+    const char* nextNewline;
+    const char* sourceEnd;
+    int line;
+    // position in the list's number column
+    size_t number;
+    Scanner* scanner;
+    Token window[PARSER_LOOKAHEAD];
+    size_t current;
+    size_t scanned;
+    Arena* arena;
+    // where string literals are interned
+    InternTable* strings;
+    // where syntax errors are printed; the calling thread's errorStream()
+    // by default
+    FILE* errorOutput;
+    bool hadError;
+    // innermost last; points at inlinePending until that overflows
+    PendingOperator* pending;
+    size_t pendingCount;
+    size_t pendingCapacity;
+    PendingOperator inlinePending[PARSER_INLINE_PENDING];
+} Parser;
 
+// Parsers are independent of each other; tokens come from the list when
+// one is given, otherwise from scanner. A parser refers to its own
+// storage, so it must not be copied once initialized.
+void initParserState(Parser* parser, Scanner* scanner, TokenList* tokens, Arena* arena, InternTable* strings);
+Expr* parseExpression(Parser* parser);
+// Programs are parsed one top-level statement at a time, so each can be
+// run and its tree released before the next is read. Returns false once
+// the input is used up; otherwise *statement is the statement's tree, or
+// NULL if it failed to parse.
+bool parseStatement(Parser* parser, Expr** statement);
 
+// the calling thread's parser, reading the thread's scanner or a list;
+// parse() and parseNext() report failures through hadParseError and hadError
+void initParser(Arena* arena);
+void initParserFromList(TokenList* tokens, Arena* arena);
+Expr* parse();
+bool parseNext(Expr** statement);
 
 #endif
 
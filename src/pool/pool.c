@@ -0,0 +1,128 @@
+#include "pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+// the indices a worker still has to run, [next, end)
+typedef struct{
+    pthread_mutex_t lock;
+    size_t next;
+    size_t end;
+    // keeps neighbouring slices off each other's cache lines
+    char padding[64];
+} WorkSlice;
+
+typedef struct{
+    WorkSlice* slices;
+    int workerCount;
+    PoolTask task;
+    void* context;
+} Pool;
+
+typedef struct{
+    Pool* pool;
+    int id;
+} Worker;
+
+static bool takeOwn(WorkSlice* slice, size_t* index){
+    pthread_mutex_lock(&slice->lock);
+    bool found = slice->next < slice->end;
+    if(found) *index = slice->next++;
+    pthread_mutex_unlock(&slice->lock);
+    return found;
+}
+
+// moves the upper half of the fullest other slice into the thief's own
+static bool steal(Pool* pool, int thief){
+    for(;;){
+        int victim = -1;
+        size_t most = 0;
+        for(int i = 0; i < pool->workerCount; i++){
+            if(i == thief) continue;
+            WorkSlice* slice = &pool->slices[i];
+            pthread_mutex_lock(&slice->lock);
+            size_t remaining = slice->end - slice->next;
+            pthread_mutex_unlock(&slice->lock);
+            if(remaining > most){
+                most = remaining;
+                victim = i;
+            }
+        }
+        if(victim < 0) return false;
+
+        WorkSlice* from = &pool->slices[victim];
+        pthread_mutex_lock(&from->lock);
+        if(from->next >= from->end){
+            pthread_mutex_unlock(&from->lock);
+            continue;
+        }
+        size_t middle = from->next + (from->end - from->next) / 2;
+        size_t end = from->end;
+        from->end = middle;
+        pthread_mutex_unlock(&from->lock);
+
+        WorkSlice* to = &pool->slices[thief];
+        pthread_mutex_lock(&to->lock);
+        to->next = middle;
+        to->end = end;
+        pthread_mutex_unlock(&to->lock);
+        return true;
+    }
+}
+
+static void* runWorker(void* arg){
+    Worker* worker = (Worker*)arg;
+    Pool* pool = worker->pool;
+    size_t index;
+    // no task adds work, so once nothing is left to steal the pool is done
+    do{
+        while(takeOwn(&pool->slices[worker->id], &index)){
+            pool->task(index, worker->id, pool->context);
+        }
+    } while(steal(pool, worker->id));
+    return NULL;
+}
+
+bool runPool(size_t count, int threadCount, PoolTask task, void* context){
+    if(threadCount < 1) threadCount = 1;
+    if((size_t)threadCount > count) threadCount = count > 0 ? (int)count : 1;
+
+    Pool pool;
+    pool.workerCount = threadCount;
+    pool.task = task;
+    pool.context = context;
+    pool.slices = (WorkSlice*)malloc(sizeof(WorkSlice) * (size_t)threadCount);
+    Worker* workers = (Worker*)malloc(sizeof(Worker) * (size_t)threadCount);
+    pthread_t* threads = (pthread_t*)malloc(sizeof(pthread_t) * (size_t)threadCount);
+    if(!pool.slices || !workers || !threads){
+        fprintf(stderr, "Failed to allocate memory for thread pool\n");
+        free(pool.slices);
+        free(workers);
+        free(threads);
+        return false;
+    }
+    for(int i = 0; i < threadCount; i++){
+        pthread_mutex_init(&pool.slices[i].lock, NULL);
+        pool.slices[i].next = count * (size_t)i / (size_t)threadCount;
+        pool.slices[i].end = count * (size_t)(i + 1) / (size_t)threadCount;
+        workers[i] = (Worker){&pool, i};
+    }
+
+    // worker 0 runs on the calling thread
+    int started = 1;
+    for(; started < threadCount; started++){
+        if(pthread_create(&threads[started], NULL, runWorker, &workers[started]) != 0) break;
+    }
+    // slices of workers that failed to start are stolen by the rest
+    runWorker(&workers[0]);
+    for(int i = 1; i < started; i++){
+        pthread_join(threads[i], NULL);
+    }
+    for(int i = 0; i < threadCount; i++){
+        pthread_mutex_destroy(&pool.slices[i].lock);
+    }
+    free(pool.slices);
+    free(workers);
+    free(threads);
+    return true;
+}
@@ -0,0 +1,17 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Runs task(index, worker, context) once for every index in [0, count)
+// on threadCount worker threads and returns when all have finished.
+//
+// Each worker starts with a contiguous slice of the indices and takes
+// them in order; a worker that runs dry steals the upper half of the
+// largest remaining slice, so uneven tasks still keep every thread busy.
+typedef void (*PoolTask)(size_t index, int worker, void* context);
+
+bool runPool(size_t count, int threadCount, PoolTask task, void* context);
+
+#endif
@@ -1,57 +1,374 @@
 #include "printer.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
+#include "../output/output.h"
+#include "../object/object.h"
 
-static void printExpr(Expr* expr){
+static void writeLexeme(Writer* writer, Token token){
+    writeBytes(writer, token.lexeme, token.length);
+}
+
+// quoted, with the characters JSON requires escaped
+static void writeJsonString(Writer* writer, const char* chars, size_t length){
+    static const char hex[] = "0123456789abcdef";
+    writeChar(writer, '"');
+    size_t start = 0;
+    for(size_t i=0;i<length;i++){
+        unsigned char c = (unsigned char)chars[i];
+        if(c >= 0x20 && c != '"' && c != '\\') continue;
+        writeBytes(writer, chars + start, i - start);
+        start = i + 1;
+        if(c == '"' || c == '\\'){
+            writeChar(writer, '\\');
+            writeChar(writer, (char)c);
+        }
+        else if(c == '\n'){
+            writeText(writer, "\\n");
+        }
+        else{
+            char escape[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 15]};
+            writeBytes(writer, escape, sizeof(escape));
+        }
+    }
+    writeBytes(writer, chars + start, length - start);
+    writeChar(writer, '"');
+}
+
+static void writeSexprLiteral(Writer* writer, Value value){
+    if(IS_STRING(value)){
+        ObjString* string = AS_STRING(value);
+        writeChar(writer, '"');
+        writeBytes(writer, string->chars, string->length);
+        writeChar(writer, '"');
+    }
+    else if(IS_BOOL(value)){
+        writeText(writer, AS_BOOL(value) ? "true" : "false");
+    }
+    else if(IS_NIL(value)){
+        writeText(writer, "nil");
+    }
+    else if(IS_INT(value)){
+        writeInt(writer, AS_INT(value));
+    }
+    else if(IS_FLOAT(value)){
+        writeFloat(writer, AS_FLOAT(value));
+    }
+}
+
+// Trees are written from an explicit stack, so depth costs heap rather
+// than call stack. An entry is either a node still to write or, with text
+// set, a piece of punctuation that closes one.
+typedef struct{
+    Expr* expr;
+    const char* text;
+} PrintItem;
+
+typedef struct{
+    PrintItem* items;
+    size_t count;
+    size_t capacity;
+} PrintStack;
+
+// room for the most any node pushes
+static bool reserveItems(PrintStack* stack){
+    if(stack->count + 4 <= stack->capacity) return true;
+    size_t capacity = stack->capacity < 64 ? 64 : stack->capacity * 2;
+    PrintItem* items = (PrintItem*)realloc(stack->items, capacity * sizeof(PrintItem));
+    if(!items){
+        fprintf(stderr, "Failure to allocate memory for printing tree");
+        return false;
+    }
+    stack->items = items;
+    stack->capacity = capacity;
+    return true;
+}
+
+static void pushNode(PrintStack* stack, Expr* expr){
+    stack->items[stack->count++] = (PrintItem){expr, NULL};
+}
+
+static void pushText(PrintStack* stack, const char* text){
+    stack->items[stack->count++] = (PrintItem){NULL, text};
+}
+
+// Each writer below writes what comes before a node's first child and
+// pushes the rest in reverse, so the left child is popped first.
+static void writeSexprNode(Writer* writer, Expr* expr, PrintStack* stack){
+    switch(expr->type){
+        case EXPR_BINARY:
+            writeText(writer, "( ");
+            writeLexeme(writer, expr->expression.binary.oper);
+            writeChar(writer, ' ');
+            pushText(stack, ")");
+            pushNode(stack, expr->expression.binary.right);
+            pushNode(stack, expr->expression.binary.left);
+            break;
+        case EXPR_UNARY:
+            writeChar(writer, '(');
+            writeLexeme(writer, expr->expression.unary.oper);
+            writeChar(writer, ' ');
+            pushText(stack, ")");
+            pushNode(stack, expr->expression.unary.right);
+            break;
+        case EXPR_GROUPING:
+            writeText(writer, "(group ");
+            pushText(stack, ")");
+            pushNode(stack, expr->expression.grouping.expression);
+            break;
+        case EXPR_LITERAL:
+            writeSexprLiteral(writer, expr->expression.literal.value);
+            break;
+    }
+}
+
+static void writeJsonLiteral(Writer* writer, Value value){
+    if(IS_STRING(value)){
+        ObjString* string = AS_STRING(value);
+        writeJsonString(writer, string->chars, string->length);
+    }
+    else if(IS_FLOAT(value) && !isfinite(AS_FLOAT(value))){
+        // JSON has no infinities or NaN
+        writeText(writer, "null");
+    }
+    else{
+        writeSexprLiteral(writer, value);
+    }
+}
+
+static void writeJsonNode(Writer* writer, Expr* expr, PrintStack* stack){
+    switch(expr->type){
+        case EXPR_BINARY:
+            writeText(writer, "{\"type\":\"binary\",\"operator\":");
+            writeJsonString(writer, expr->expression.binary.oper.lexeme, expr->expression.binary.oper.length);
+            writeText(writer, ",\"left\":");
+            pushText(stack, "}");
+            pushNode(stack, expr->expression.binary.right);
+            pushText(stack, ",\"right\":");
+            pushNode(stack, expr->expression.binary.left);
+            break;
+        case EXPR_UNARY:
+            writeText(writer, "{\"type\":\"unary\",\"operator\":");
+            writeJsonString(writer, expr->expression.unary.oper.lexeme, expr->expression.unary.oper.length);
+            writeText(writer, ",\"right\":");
+            pushText(stack, "}");
+            pushNode(stack, expr->expression.unary.right);
+            break;
+        case EXPR_GROUPING:
+            writeText(writer, "{\"type\":\"grouping\",\"expression\":");
+            pushText(stack, "}");
+            pushNode(stack, expr->expression.grouping.expression);
+            break;
+        case EXPR_LITERAL:
+            writeText(writer, "{\"type\":\"literal\",\"value\":");
+            writeJsonLiteral(writer, expr->expression.literal.value);
+            writeChar(writer, '}');
+            break;
+    }
+}
+
+static void writeBinaryLiteral(Writer* writer, Value value){
+    if(IS_STRING(value)){
+        ObjString* string = AS_STRING(value);
+        writeU8(writer, LITERAL_STRING);
+        writeU32(writer, (uint32_t)string->length);
+        writeBytes(writer, string->chars, string->length);
+    }
+    else if(IS_BOOL(value)){
+        writeU8(writer, AS_BOOL(value) ? LITERAL_TRUE : LITERAL_FALSE);
+    }
+    else if(IS_NIL(value)){
+        writeU8(writer, LITERAL_NIL);
+    }
+    else if(IS_INT(value)){
+        writeU8(writer, LITERAL_INT);
+        writeU64(writer, (uint64_t)AS_INT(value));
+    }
+    else{
+        // a float's Value is its IEEE bits
+        writeU8(writer, LITERAL_FLOAT);
+        writeU64(writer, value);
+    }
+}
+
+static void writeBinaryNode(Writer* writer, Expr* expr, PrintStack* stack){
+    writeU8(writer, (uint8_t)expr->type);
     switch(expr->type){
         case EXPR_BINARY:
-            printf("(");
-            printf(" %s ", expr->expression.binary.oper.lexeme);
-            printValue(expr->expression.binary.left);
-            printValue(expr->expression.binary.right);
-            printf(")");
+            writeU8(writer, (uint8_t)expr->expression.binary.oper.type);
+            pushNode(stack, expr->expression.binary.right);
+            pushNode(stack, expr->expression.binary.left);
             break;
         case EXPR_UNARY:
-            printf("(");
-            printf("%s ", expr->expression.unary.oper.lexeme);
-            printValue(expr->expression.unary.right);
-            printf(")");
+            writeU8(writer, (uint8_t)expr->expression.unary.oper.type);
+            pushNode(stack, expr->expression.unary.right);
             break;
         case EXPR_GROUPING:
-            printf("(group ");
-            printValue(expr->expression.grouping.expression);
-            printf(")");
+            pushNode(stack, expr->expression.grouping.expression);
             break;
         case EXPR_LITERAL:
-            switch(expr->expression.literal.type){
-                case LITERAL_INTEGER:
-                    printf("%d", expr->expression.literal.value.number.integer);
-                    break;
-                case LITERAL_FLOAT:
-                    printf("%f", expr->expression.literal.value.number.floating);
-                    break;
-                case LITERAL_STRING:
-                    printf("\"%s\"", expr->expression.literal.value.string);
-                    break;
-                case LITERAL_BOOLEAN:
-                    printf("%s", (expr->expression.literal.value.boolean) ? "true" : "false");
-                    break;
-                case LITERAL_NIL:
-                    printf("nil");
-                    break;
+            writeBinaryLiteral(writer, expr->expression.literal.value);
+            break;
+    }
+}
+
+static void writeNodes(Writer* writer, Expr* root, DumpFormat format){
+    PrintStack stack = {NULL, 0, 0};
+    if(!reserveItems(&stack)) return;
+    pushNode(&stack, root);
+    while(stack.count > 0){
+        PrintItem item = stack.items[--stack.count];
+        if(item.text){
+            writeText(writer, item.text);
+            continue;
+        }
+        // a missing operand from a failed parse writes nothing
+        if(!item.expr) continue;
+        if(item.expr->type != EXPR_LITERAL && !reserveItems(&stack)) break;
+        switch(format){
+            case DUMP_SEXPR: writeSexprNode(writer, item.expr, &stack); break;
+            case DUMP_JSON: writeJsonNode(writer, item.expr, &stack); break;
+            case DUMP_BINARY: writeBinaryNode(writer, item.expr, &stack); break;
+        }
+    }
+    free(stack.items);
+}
+
+void writeTree(Writer* writer, Expr* expr, DumpFormat format){
+    switch(format){
+        case DUMP_SEXPR:
+            writeNodes(writer, expr, format);
+            break;
+        case DUMP_JSON:
+            writeNodes(writer, expr, format);
+            writeChar(writer, '\n');
+            break;
+        case DUMP_BINARY:
+            writeText(writer, "LOXT");
+            writeU8(writer, DUMP_BINARY_VERSION);
+            writeNodes(writer, expr, format);
+            break;
+    }
+}
+
+// lines are looked up only for the formats that print them
+static Token listToken(TokenList* list, size_t index, size_t* newline){
+    Token token;
+    token.type = (TokenType)list->types[index];
+    token.lexeme = list->source + list->offsets[index];
+    token.length = list->lengths[index];
+    token.line = newline ? tokenLineFrom(list, index, newline) : 0;
+    return token;
+}
+
+void writeTokens(Writer* writer, TokenList* list, DumpFormat format){
+    size_t newline = 0;
+    switch(format){
+        case DUMP_SEXPR:
+            for(size_t i=0;i<list->count;i++){
+                Token token = listToken(list, i, NULL);
+                writeText(writer, "Type: ");
+                writeInt(writer, token.type);
+                writeText(writer, " Token: \"");
+                writeLexeme(writer, token);
+                writeText(writer, "\"\n");
             }
             break;
-        default:
-            fprintf(stderr, "Invalid expression type");
+        case DUMP_JSON:
+            writeChar(writer, '[');
+            for(size_t i=0;i<list->count;i++){
+                Token token = listToken(list, i, &newline);
+                if(i > 0) writeChar(writer, ',');
+                writeText(writer, "{\"type\":");
+                writeInt(writer, token.type);
+                writeText(writer, ",\"line\":");
+                writeInt(writer, token.line);
+                writeText(writer, ",\"lexeme\":");
+                writeJsonString(writer, token.lexeme, token.length);
+                writeChar(writer, '}');
+            }
+            writeText(writer, "]\n");
+            break;
+        case DUMP_BINARY:
+            writeText(writer, "LOXK");
+            writeU8(writer, DUMP_BINARY_VERSION);
+            writeU32(writer, (uint32_t)list->count);
+            for(size_t i=0;i<list->count;i++){
+                Token token = listToken(list, i, &newline);
+                writeU8(writer, (uint8_t)token.type);
+                writeU32(writer, (uint32_t)token.line);
+                writeU32(writer, (uint32_t)token.length);
+                writeLexeme(writer, token);
+            }
             break;
     }
 }
 
+static const char* flatOperators[] = {
+    [FLAT_NEGATE] = "-", [FLAT_NOT] = "!",
+    [FLAT_ADD] = "+", [FLAT_SUBTRACT] = "-", [FLAT_MULTIPLY] = "*", [FLAT_DIVIDE] = "/",
+    [FLAT_EQUAL] = "==", [FLAT_NOT_EQUAL] = "!=",
+    [FLAT_GREATER] = ">", [FLAT_GREATER_EQUAL] = ">=",
+    [FLAT_LESS] = "<", [FLAT_LESS_EQUAL] = "<=",
+};
+
+// set on a stack entry that closes its node's parenthesis
+#define FLAT_CLOSE 0x80000000u
+
+void writeFlatTree(Writer* writer, const FlatTree* tree){
+    if(tree->count == 0) return;
+    // every node pushes at most its close and two children
+    uint32_t* stack = (uint32_t*)malloc(sizeof(uint32_t) * (2 * (size_t)tree->count + 1));
+    if(!stack){
+        fprintf(stderr, "Failure to allocate memory for printing flat tree");
+        return;
+    }
+    size_t count = 0;
+    stack[count++] = tree->count - 1;
+    while(count > 0){
+        uint32_t entry = stack[--count];
+        if(entry & FLAT_CLOSE){
+            writeChar(writer, ')');
+            continue;
+        }
+        const FlatNode* node = &tree->nodes[entry];
+        switch((FlatKind)node->kind){
+            case FLAT_LITERAL:
+                writeSexprLiteral(writer, node->as.value);
+                continue;
+            case FLAT_GROUPING:
+                writeText(writer, "(group ");
+                break;
+            case FLAT_NEGATE:
+            case FLAT_NOT:
+                writeChar(writer, '(');
+                writeText(writer, flatOperators[node->kind]);
+                writeChar(writer, ' ');
+                break;
+            default:
+                writeText(writer, "( ");
+                writeText(writer, flatOperators[node->kind]);
+                writeChar(writer, ' ');
+                stack[count++] = entry | FLAT_CLOSE;
+                // the left operand is popped, and so written, first
+                stack[count++] = node->as.children.right;
+                stack[count++] = node->as.children.left;
+                continue;
+        }
+        stack[count++] = entry | FLAT_CLOSE;
+        stack[count++] = node->as.children.left;
+    }
+    free(stack);
+}
+
 void printValue(Expr* expr){
     if(expr){
-        printExpr(expr);
+        Writer writer;
+        initWriter(&writer, outputStream());
+        writeNodes(&writer, expr, DUMP_SEXPR);
+        flushWriter(&writer);
     }
     else{
-        fprintf(stderr, "Expression is NULL");
+        fprintf(errorStream(), "Expression is NULL");
     }
-}
\ No newline at end of file
+}
@@ -2,7 +2,39 @@
 #define PRINTER_H
 
 #include "../expression/expression.h"
+#include "../output/writer.h"
+#include "../flat/flat.h"
 
+typedef enum{
+    DUMP_SEXPR,     // the text form printValue has always used
+    DUMP_JSON,      // one JSON document per dump
+    DUMP_BINARY     // compact little-endian form, described below
+} DumpFormat;
+
+// Binary trees start with "LOXT" and a version byte, then each node in
+// preorder: its ExprType byte, then for binary and unary nodes the
+// operator's TokenType byte, then the children. Literals follow with a
+// LiteralTag byte and the payload: i64 or f64 bits, or a u32 length and
+// the string's bytes.
+// Binary token lists start with "LOXK", a version byte and a u32 count,
+// then per token its TokenType byte, u32 line, u32 length and lexeme.
+#define DUMP_BINARY_VERSION 1
+
+typedef enum{
+    LITERAL_NIL,
+    LITERAL_FALSE,
+    LITERAL_TRUE,
+    LITERAL_INT,
+    LITERAL_FLOAT,
+    LITERAL_STRING
+} LiteralTag;
+
+// S-expression of the tree on outputStream()
 void printValue(Expr* expr);
 
-#endif
\ No newline at end of file
+void writeTree(Writer* writer, Expr* expr, DumpFormat format);
+void writeTokens(Writer* writer, TokenList* list, DumpFormat format);
+// the S-expression of a flat tree, written without recursion
+void writeFlatTree(Writer* writer, const FlatTree* tree);
+
+#endif
@@ -0,0 +1,279 @@
+#include "kernels.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HAVE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+// Scalar kernels, used on every platform and for the tails of SIMD scans
+
+static inline bool isWhitespaceChar(char c){
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static inline bool isIdentifierChar(char c){
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+static const char* scalarSkipWhitespace(const char* p, const char* end, int* line){
+    while(p < end && isWhitespaceChar(*p)){
+        if(*p == '\n') (*line)++;
+        p++;
+    }
+    return p;
+}
+
+static const char* scalarFindLineEnd(const char* p, const char* end){
+    while(p < end && *p != '\n' && *p != '\0') p++;
+    return p;
+}
+
+static const char* scalarFindStringEnd(const char* p, const char* end, int* line){
+    while(p < end && *p != '"' && *p != '\0'){
+        if(*p == '\n') (*line)++;
+        p++;
+    }
+    return p;
+}
+
+static const char* scalarSkipIdentifier(const char* p, const char* end){
+    while(p < end && isIdentifierChar(*p)) p++;
+    return p;
+}
+
+static const char* scalarSkipDigits(const char* p, const char* end){
+    while(p < end && *p >= '0' && *p <= '9') p++;
+    return p;
+}
+
+static const ScanKernels scalarKernels = {
+    "scalar",
+    scalarSkipWhitespace,
+    scalarFindLineEnd,
+    scalarFindStringEnd,
+    scalarSkipIdentifier,
+    scalarSkipDigits
+};
+
+#ifdef HAVE_X86_KERNELS
+
+// bits below the first set bit of mask
+#define BITS_BEFORE(mask) (((mask) & -(mask)) - 1)
+
+// SSE2 kernels: 16 bytes per step, movemask turns lane compares into bits
+
+static inline __m128i sse2InRange(__m128i chars, char low, char high){
+    return _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8((char)(low - 1))),
+                         _mm_cmplt_epi8(chars, _mm_set1_epi8((char)(high + 1))));
+}
+
+static const char* sse2SkipWhitespace(const char* p, const char* end, int* line){
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i carriage = _mm_set1_epi8('\r');
+    const __m128i newline = _mm_set1_epi8('\n');
+    while(end - p >= 16){
+        __m128i chars = _mm_loadu_si128((const __m128i*)p);
+        __m128i newlines = _mm_cmpeq_epi8(chars, newline);
+        __m128i blanks = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chars, space), _mm_cmpeq_epi8(chars, tab)),
+                                      _mm_or_si128(_mm_cmpeq_epi8(chars, carriage), newlines));
+        uint32_t stop = ~(uint32_t)_mm_movemask_epi8(blanks) & 0xffff;
+        uint32_t lines = (uint32_t)_mm_movemask_epi8(newlines);
+        if(stop){
+            *line += __builtin_popcount(lines & BITS_BEFORE(stop));
+            return p + __builtin_ctz(stop);
+        }
+        *line += __builtin_popcount(lines);
+        p += 16;
+    }
+    return scalarSkipWhitespace(p, end, line);
+}
+
+static const char* sse2FindLineEnd(const char* p, const char* end){
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i zero = _mm_setzero_si128();
+    while(end - p >= 16){
+        __m128i chars = _mm_loadu_si128((const __m128i*)p);
+        uint32_t stop = (uint32_t)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chars, newline), _mm_cmpeq_epi8(chars, zero)));
+        if(stop) return p + __builtin_ctz(stop);
+        p += 16;
+    }
+    return scalarFindLineEnd(p, end);
+}
+
+static const char* sse2FindStringEnd(const char* p, const char* end, int* line){
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i zero = _mm_setzero_si128();
+    while(end - p >= 16){
+        __m128i chars = _mm_loadu_si128((const __m128i*)p);
+        uint32_t stop = (uint32_t)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chars, quote), _mm_cmpeq_epi8(chars, zero)));
+        uint32_t lines = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chars, newline));
+        if(stop){
+            *line += __builtin_popcount(lines & BITS_BEFORE(stop));
+            return p + __builtin_ctz(stop);
+        }
+        *line += __builtin_popcount(lines);
+        p += 16;
+    }
+    return scalarFindStringEnd(p, end, line);
+}
+
+static const char* sse2SkipIdentifier(const char* p, const char* end){
+    const __m128i lowerBit = _mm_set1_epi8(0x20);
+    const __m128i underscore = _mm_set1_epi8('_');
+    while(end - p >= 16){
+        __m128i chars = _mm_loadu_si128((const __m128i*)p);
+        // folding case maps both letter ranges onto a-z
+        __m128i letters = sse2InRange(_mm_or_si128(chars, lowerBit), 'a', 'z');
+        __m128i word = _mm_or_si128(_mm_or_si128(letters, sse2InRange(chars, '0', '9')), _mm_cmpeq_epi8(chars, underscore));
+        uint32_t stop = ~(uint32_t)_mm_movemask_epi8(word) & 0xffff;
+        if(stop) return p + __builtin_ctz(stop);
+        p += 16;
+    }
+    return scalarSkipIdentifier(p, end);
+}
+
+static const char* sse2SkipDigits(const char* p, const char* end){
+    while(end - p >= 16){
+        __m128i chars = _mm_loadu_si128((const __m128i*)p);
+        uint32_t stop = ~(uint32_t)_mm_movemask_epi8(sse2InRange(chars, '0', '9')) & 0xffff;
+        if(stop) return p + __builtin_ctz(stop);
+        p += 16;
+    }
+    return scalarSkipDigits(p, end);
+}
+
+static const ScanKernels sse2Kernels = {
+    "sse2",
+    sse2SkipWhitespace,
+    sse2FindLineEnd,
+    sse2FindStringEnd,
+    sse2SkipIdentifier,
+    sse2SkipDigits
+};
+
+// AVX2 kernels: the same algorithms 32 bytes at a time, compiled for
+// AVX2 without requiring it for the rest of the program
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static inline __m256i avx2InRange(__m256i chars, char low, char high){
+    return _mm256_and_si256(_mm256_cmpgt_epi8(chars, _mm256_set1_epi8((char)(low - 1))),
+                            _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(high + 1)), chars));
+}
+
+AVX2 static const char* avx2SkipWhitespace(const char* p, const char* end, int* line){
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i carriage = _mm256_set1_epi8('\r');
+    const __m256i newline = _mm256_set1_epi8('\n');
+    while(end - p >= 32){
+        __m256i chars = _mm256_loadu_si256((const __m256i*)p);
+        __m256i newlines = _mm256_cmpeq_epi8(chars, newline);
+        __m256i blanks = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chars, space), _mm256_cmpeq_epi8(chars, tab)),
+                                         _mm256_or_si256(_mm256_cmpeq_epi8(chars, carriage), newlines));
+        uint32_t stop = ~(uint32_t)_mm256_movemask_epi8(blanks);
+        uint32_t lines = (uint32_t)_mm256_movemask_epi8(newlines);
+        if(stop){
+            *line += __builtin_popcount(lines & BITS_BEFORE(stop));
+            return p + __builtin_ctz(stop);
+        }
+        *line += __builtin_popcount(lines);
+        p += 32;
+    }
+    return sse2SkipWhitespace(p, end, line);
+}
+
+AVX2 static const char* avx2FindLineEnd(const char* p, const char* end){
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i zero = _mm256_setzero_si256();
+    while(end - p >= 32){
+        __m256i chars = _mm256_loadu_si256((const __m256i*)p);
+        uint32_t stop = (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(chars, newline), _mm256_cmpeq_epi8(chars, zero)));
+        if(stop) return p + __builtin_ctz(stop);
+        p += 32;
+    }
+    return sse2FindLineEnd(p, end);
+}
+
+AVX2 static const char* avx2FindStringEnd(const char* p, const char* end, int* line){
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i zero = _mm256_setzero_si256();
+    while(end - p >= 32){
+        __m256i chars = _mm256_loadu_si256((const __m256i*)p);
+        uint32_t stop = (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(chars, quote), _mm256_cmpeq_epi8(chars, zero)));
+        uint32_t lines = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chars, newline));
+        if(stop){
+            *line += __builtin_popcount(lines & BITS_BEFORE(stop));
+            return p + __builtin_ctz(stop);
+        }
+        *line += __builtin_popcount(lines);
+        p += 32;
+    }
+    return sse2FindStringEnd(p, end, line);
+}
+
+AVX2 static const char* avx2SkipIdentifier(const char* p, const char* end){
+    const __m256i lowerBit = _mm256_set1_epi8(0x20);
+    const __m256i underscore = _mm256_set1_epi8('_');
+    while(end - p >= 32){
+        __m256i chars = _mm256_loadu_si256((const __m256i*)p);
+        __m256i letters = avx2InRange(_mm256_or_si256(chars, lowerBit), 'a', 'z');
+        __m256i word = _mm256_or_si256(_mm256_or_si256(letters, avx2InRange(chars, '0', '9')), _mm256_cmpeq_epi8(chars, underscore));
+        uint32_t stop = ~(uint32_t)_mm256_movemask_epi8(word);
+        if(stop) return p + __builtin_ctz(stop);
+        p += 32;
+    }
+    return sse2SkipIdentifier(p, end);
+}
+
+AVX2 static const char* avx2SkipDigits(const char* p, const char* end){
+    while(end - p >= 32){
+        __m256i chars = _mm256_loadu_si256((const __m256i*)p);
+        uint32_t stop = ~(uint32_t)_mm256_movemask_epi8(avx2InRange(chars, '0', '9'));
+        if(stop) return p + __builtin_ctz(stop);
+        p += 32;
+    }
+    return sse2SkipDigits(p, end);
+}
+
+static const ScanKernels avx2Kernels = {
+    "avx2",
+    avx2SkipWhitespace,
+    avx2FindLineEnd,
+    avx2FindStringEnd,
+    avx2SkipIdentifier,
+    avx2SkipDigits
+};
+
+#endif
+
+static const ScanKernels* selectedKernels = &scalarKernels;
+static pthread_once_t selectOnce = PTHREAD_ONCE_INIT;
+
+static void selectKernels(){
+    const char* requested = getenv("LOX_SCAN_KERNELS");
+    if(requested && strcmp(requested, "scalar") == 0) return;
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    bool wantSse2 = requested && strcmp(requested, "sse2") == 0;
+    if(!wantSse2 && __builtin_cpu_supports("avx2")){
+        selectedKernels = &avx2Kernels;
+    }
+    else if(__builtin_cpu_supports("sse2")){
+        selectedKernels = &sse2Kernels;
+    }
+#endif
+}
+
+const ScanKernels* getScanKernels(){
+    pthread_once(&selectOnce, selectKernels);
+    return selectedKernels;
+}
@@ -0,0 +1,25 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+// Bulk character-class scans used by the scanner's hot loops. Every
+// kernel reads only [p, end) and stops early at a NUL byte, so results
+// match the byte-at-a-time scanner exactly.
+typedef struct ScanKernels{
+    const char* name;
+    // skips spaces, tabs, carriage returns and newlines, counting newlines
+    const char* (*skipWhitespace)(const char* p, const char* end, int* line);
+    // finds the '\n' (or NUL) that ends a line comment
+    const char* (*findLineEnd)(const char* p, const char* end);
+    // finds the closing '"' (or NUL) of a string body, counting newlines
+    const char* (*findStringEnd)(const char* p, const char* end, int* line);
+    // end of a run of [A-Za-z0-9_]
+    const char* (*skipIdentifier)(const char* p, const char* end);
+    // end of a run of [0-9]
+    const char* (*skipDigits)(const char* p, const char* end);
+} ScanKernels;
+
+// Picks the widest kernels the CPU supports, once per process. Setting
+// LOX_SCAN_KERNELS to "scalar", "sse2" or "avx2" overrides the choice.
+const ScanKernels* getScanKernels();
+
+#endif
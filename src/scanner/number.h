@@ -0,0 +1,14 @@
+#ifndef NUMBER_H
+#define NUMBER_H
+
+#include <stddef.h>
+#include "../value/value.h"
+
+// Decodes a number lexeme, [0-9]+ with an optional .[0-9]+, as the scanner
+// finds it. Integers that fit the boxed range, below 2^47, stay integers;
+// everything else becomes the correctly rounded double, without a
+// warning. Integers past 2^53 therefore lose digits: 9007199254740993
+// becomes 9007199254740992.
+Value decodeNumber(const char* lexeme, size_t length);
+
+#endif
@@ -0,0 +1,229 @@
+#include "scanner.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "../stats/stats.h"
+
+// pieces smaller than this are not worth a thread
+#define MIN_CHUNK_SIZE (1u << 20)
+
+typedef struct{
+    const char* start;
+    const char* end;
+    // offsets are from the start of the whole scan, so tokens copy as they
+    // are; error lines are the chunk's own, starting at 1
+    const char* source;
+    TokenList tokens;
+    Token eof;
+    ScanErrorList errors;
+    int newlines;
+    // merge step
+    TokenList* destination;
+    size_t first;
+    size_t firstNumber;
+    int lineOffset;
+    // what a helper thread runs, and what it counted while running it
+    void* (*body)(void*);
+    Stats stats;
+} ScanChunk;
+
+int scanThreadCount(){
+    const char* setting = getenv("LOX_SCAN_THREADS");
+    if(setting && atoi(setting) > 0) return atoi(setting);
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? (int)cpus : 1;
+}
+
+// Returns the position just past the first newline at or after target
+// that is outside strings and comments, or NULL if the source (or a NUL
+// byte, which ends scanning) comes first. p must be a position in code.
+static const char* findBoundary(const char* p, const char* target){
+    for(;;){
+        const char* special = strpbrk(p, "\"/");
+        // everything between p and special is code, so any newline there will do
+        const char* from = p > target ? p : target;
+        const char* stop = special ? special : p + strlen(p);
+        if(from < stop){
+            const char* newline = memchr(from, '\n', (size_t)(stop - from));
+            if(newline) return newline + 1;
+        }
+        if(!special) return NULL;
+        if(special[0] == '"'){
+            const char* close = strchr(special + 1, '"');
+            if(!close) return NULL;
+            p = close + 1;
+        }
+        else if(special[1] == '/'){
+            // the newline that ends a comment is code again
+            p = strchr(special + 2, '\n');
+            if(!p) return NULL;
+        }
+        else{
+            p = special + 1;
+        }
+    }
+}
+
+static void* scanChunk(void* arg){
+    ScanChunk* chunk = (ScanChunk*)arg;
+    Scanner scanner;
+    initScannerState(&scanner, chunk->start, (size_t)(chunk->end - chunk->start));
+    scanner.errors = &chunk->errors;
+    initTokenList(&chunk->tokens, chunk->source, 1);
+    // left to grow: a token per byte in deep nesting, one per thirty in
+    // comments, so any up-front guess mostly over- or under-reserves
+    while(!chunk->tokens.failed){
+        Token token = scanToken(&scanner);
+        if(token.type == TOKEN_EOF){
+            chunk->eof = token;
+            break;
+        }
+        addToken(&chunk->tokens, token);
+    }
+    chunk->newlines = scanner.line - 1;
+    return NULL;
+}
+
+static void* copyChunk(void* arg){
+    ScanChunk* chunk = (ScanChunk*)arg;
+    TokenList* list = chunk->destination;
+    size_t count = chunk->tokens.count;
+    memcpy(list->types + chunk->first, chunk->tokens.types, count);
+    memcpy(list->offsets + chunk->first, chunk->tokens.offsets, count * sizeof(uint32_t));
+    memcpy(list->lengths + chunk->first, chunk->tokens.lengths, count * sizeof(uint32_t));
+    size_t numbers = chunk->tokens.numberCount;
+    if(numbers == 0) return NULL;
+    memcpy(list->numbers + chunk->firstNumber, chunk->tokens.numbers, numbers * sizeof(Value));
+    // the chunk numbered its tokens from 0
+    for(size_t i = 0; i < numbers; i++){
+        list->numberTokens[chunk->firstNumber + i] = chunk->tokens.numberTokens[i] + (uint32_t)chunk->first;
+    }
+    return NULL;
+}
+
+static void* runHelper(void* arg){
+    ScanChunk* chunk = (ScanChunk*)arg;
+    chunk->body(chunk);
+    STATS_COLLECT(&chunk->stats);
+    return NULL;
+}
+
+// runs body over every chunk, the first on the calling thread; what the
+// helper threads count is added to the caller's stats as they are joined
+static void runChunks(ScanChunk* chunks, size_t count, void* (*body)(void*)){
+    pthread_t threads[count];
+    bool started[count];
+    for(size_t i = 1; i < count; i++){
+        chunks[i].body = body;
+        started[i] = pthread_create(&threads[i], NULL, runHelper, &chunks[i]) == 0;
+        if(!started[i]) body(&chunks[i]);
+    }
+    body(&chunks[0]);
+    for(size_t i = 1; i < count; i++){
+        if(!started[i]) continue;
+        pthread_join(threads[i], NULL);
+        STATS_MERGE(&chunks[i].stats);
+    }
+}
+
+static TokenList scanSerially(Scanner* scanner){
+    TokenList list;
+    initTokenList(&list, scanner->current, scanner->line);
+    Token token;
+    do{
+        token = scanToken(scanner);
+        addToken(&list, token);
+    } while(token.type != TOKEN_EOF && !list.failed);
+    return list;
+}
+
+TokenList scanTokensParallel(Scanner* scanner, int threadCount){
+    const char* start = scanner->current;
+    size_t length = (size_t)(scanner->end - start);
+    size_t chunkCount = (size_t)threadCount;
+    if(length / MIN_CHUNK_SIZE < chunkCount) chunkCount = length / MIN_CHUNK_SIZE;
+    if(chunkCount < 2) return scanSerially(scanner);
+
+    ScanChunk* chunks = (ScanChunk*)calloc(chunkCount, sizeof(ScanChunk));
+    if(!chunks) return scanSerially(scanner);
+
+    // the pre-pass walks the source once, skipping strings and comments whole
+    size_t count = 0;
+    for(size_t i = 0; i < chunkCount; i++) chunks[i].source = start;
+    chunks[0].start = start;
+    for(size_t i = 1; i < chunkCount; i++){
+        const char* target = start + length / chunkCount * i;
+        const char* boundary = findBoundary(chunks[count].start, target);
+        if(!boundary || boundary >= scanner->end) break;
+        chunks[count++].end = boundary;
+        chunks[count].start = boundary;
+    }
+    chunks[count++].end = scanner->end;
+
+    runChunks(chunks, count, scanChunk);
+
+    size_t total = 1;
+    size_t totalNumbers = 0;
+    bool scanned = true;
+    int lineOffset = scanner->line - 1;
+    for(size_t i = 0; i < count; i++){
+        chunks[i].lineOffset = lineOffset;
+        lineOffset += chunks[i].newlines;
+        total += chunks[i].tokens.count;
+        totalNumbers += chunks[i].tokens.numberCount;
+        scanned = scanned && !chunks[i].tokens.failed;
+    }
+
+    TokenList list;
+    initTokenList(&list, start, scanner->line);
+    bool merged = scanned && !list.failed && reserveTokenList(&list, total) && reserveTokenNumbers(&list, totalNumbers);
+    if(merged){
+        size_t first = 0;
+        size_t firstNumber = 0;
+        for(size_t i = 0; i < count; i++){
+            chunks[i].destination = &list;
+            chunks[i].first = first;
+            chunks[i].firstNumber = firstNumber;
+            first += chunks[i].tokens.count;
+            firstNumber += chunks[i].tokens.numberCount;
+        }
+        runChunks(chunks, count, copyChunk);
+        list.count = total - 1;
+        list.numberCount = totalNumbers;
+    }
+
+    // errors come out in source order, just as a serial scan prints them
+    for(size_t i = 0; i < count; i++){
+        for(size_t j = 0; j < chunks[i].errors.count; j++){
+            ScanError error = chunks[i].errors.errors[j];
+            reportScanError(scanner->errorOutput, error.line + chunks[i].lineOffset, error.message);
+            scanner->hadError = true;
+        }
+    }
+
+    if(merged){
+        ScanChunk* last = &chunks[count-1];
+        Token eof = last->eof;
+        eof.line += last->lineOffset;
+        addToken(&list, eof);
+        // leave the scanner where a serial scan would have
+        scanner->start = eof.lexeme;
+        scanner->current = eof.lexeme;
+        scanner->line = eof.line;
+    }
+    else{
+        // a piece that failed stopped short of its end, so there is no EOF
+        list.failed = true;
+        scanner->start = scanner->end;
+        scanner->current = scanner->end;
+    }
+
+    for(size_t i = 0; i < count; i++){
+        freeTokenList(&chunks[i].tokens);
+        freeScanErrors(&chunks[i].errors);
+    }
+    free(chunks);
+    return list;
+}
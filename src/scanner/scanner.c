@@ -3,256 +3,443 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdbool.h>
-#include "../hash/hashtable.h"
+#include "kernels.h"
+#include "number.h"
+#include "../stats/stats.h"
+#include "../output/output.h"
 
-Scanner scanner;
-bool hadError = false;
-Table keywordsTable;
+_Thread_local Scanner scanner;
+_Thread_local bool hadError = false;
 
 // Forward declarations of static functions
-static char peek();
-static char peekNext();
-static char advance();
-static bool match(char expected);
-static void error(int line, char* message);
-static void report(int line, char* where, char* message);
-static void string(TokenList* list);
-static void number(TokenList* list);
-static void identifier(TokenList* list);
+static char peek(Scanner* scanner);
+static char peekNext(Scanner* scanner);
+static char advance(Scanner* scanner);
+static bool match(Scanner* scanner, char expected);
+static bool isAtEnd(Scanner* scanner);
+static Token makeScannerToken(Scanner* scanner, TokenType type, bool trimQuotes);
+static void error(Scanner* scanner, char* message);
+static bool string(Scanner* scanner);
+static Token number(Scanner* scanner);
+static Token identifier(Scanner* scanner);
+static TokenType identifierType(Scanner* scanner);
+static TokenType checkKeyword(Scanner* scanner, size_t start, size_t length, const char* rest, TokenType type);
 static bool isDigit(char c);
 static bool isAlpha(char c);
-static bool isAlphaNumeric(char c);
 
-void initScanner(const char* source){
-    scanner.start = source;
-    scanner.current=source;
-    scanner.line=1; 
+void initScanner(const char* source, size_t length){
+    initScannerState(&scanner, source, length);
 }
 
-void initKeywordsTable(){
-    initTable(&keywordsTable);
-    makeEntry(&keywordsTable,"and",(void*)(uintptr_t)TOKEN_AND);
-    makeEntry(&keywordsTable,"class",(void*)(uintptr_t)TOKEN_CLASS);
-    makeEntry(&keywordsTable,"else",(void*)(uintptr_t)TOKEN_ELSE);
-    makeEntry(&keywordsTable,"false",(void*)(uintptr_t)TOKEN_FALSE);
-    makeEntry(&keywordsTable,"for",(void*)(uintptr_t)TOKEN_FOR);
-    makeEntry(&keywordsTable,"fun",(void*)(uintptr_t)TOKEN_FUN);
-    makeEntry(&keywordsTable,"if",(void*)(uintptr_t)TOKEN_IF);
-    makeEntry(&keywordsTable,"nil",(void*)(uintptr_t)TOKEN_NIL);
-    makeEntry(&keywordsTable,"or",(void*)(uintptr_t)TOKEN_OR);
-    makeEntry(&keywordsTable,"print",(void*)(uintptr_t)TOKEN_PRINT);
-    makeEntry(&keywordsTable,"return",(void*)(uintptr_t)TOKEN_RETURN);
-    makeEntry(&keywordsTable,"super",(void*)(uintptr_t)TOKEN_SUPER);
-    makeEntry(&keywordsTable,"this",(void*)(uintptr_t)TOKEN_THIS);
-    makeEntry(&keywordsTable,"true",(void*)(uintptr_t)TOKEN_TRUE);
-    makeEntry(&keywordsTable,"var",(void*)(uintptr_t)TOKEN_VAR);
-    makeEntry(&keywordsTable,"while",(void*)(uintptr_t)TOKEN_WHILE);
+void initScannerState(Scanner* scanner, const char* source, size_t length){
+    scanner->start = source;
+    scanner->current = source;
+    scanner->end = source + length;
+    scanner->line = 1;
+    scanner->errors = NULL;
+    scanner->errorOutput = errorStream();
+    scanner->hadError = false;
+    scanner->kernels = getScanKernels();
+}
 
+void initTokenList(TokenList* list, const char* source, int firstLine){
+    list->source = source;
+    list->firstLine = firstLine;
+    list->types = NULL;
+    list->offsets = NULL;
+    list->lengths = NULL;
+    list->count = 0;
+    list->capacity = 0;
+    list->failed = false;
+    list->newlines = NULL;
+    list->newlineCount = 0;
+    list->indexed = false;
+    list->numbers = NULL;
+    list->numberTokens = NULL;
+    list->numberCount = 0;
+    list->numberCapacity = 0;
+    if(!reserveTokenList(list, 8)) list->failed = true;
 }
 
-void initTokenList(TokenList* list){
-    list->count=0;
-    list->capacity=8;
-    list->tokens = (Token*)malloc(sizeof(Token)*list->capacity);
-    if(!list->tokens){
-        fprintf(stderr,"Failure to allocate memory for token list");
-        return;
+bool reserveTokenList(TokenList* list, size_t capacity){
+    if(capacity <= list->capacity) return true;
+    STAT_ALLOC(capacity * (sizeof(uint8_t) + 2 * sizeof(uint32_t)));
+    uint8_t* types = (uint8_t*)realloc(list->types, capacity);
+    if(types) list->types = types;
+    uint32_t* offsets = (uint32_t*)realloc(list->offsets, capacity * sizeof(uint32_t));
+    if(offsets) list->offsets = offsets;
+    uint32_t* lengths = (uint32_t*)realloc(list->lengths, capacity * sizeof(uint32_t));
+    if(lengths) list->lengths = lengths;
+    if(!types || !offsets || !lengths){
+        fprintf(stderr,"Failure to reallocate memory for token list");
+        return false;
     }
+    list->capacity = capacity;
+    return true;
 }
 
 Token makeToken(TokenType type, bool trimQuotes){
+    return makeScannerToken(&scanner, type, trimQuotes);
+}
+
+static Token makeScannerToken(Scanner* scanner, TokenType type, bool trimQuotes){
     Token token;
     token.type=type;
-    const char* start = scanner.start;
-    const char* current = scanner.current;
+    const char* start = scanner->start;
+    const char* current = scanner->current;
     if(trimQuotes && type==TOKEN_STRING){
         start++;
         current--;
     }
+    // the lexeme is a slice into the source buffer, which must outlive the token
+    token.lexeme = start;
     token.length=current-start;
-    token.lexeme = (char*)malloc(sizeof(char)*token.length+1);
-    memcpy(token.lexeme,start,token.length);
-    ((char*)token.lexeme)[token.length]='\0';
-    token.line=scanner.line;
+    token.line=scanner->line;
     return token;
 }
 
 void addToken(TokenList* list, Token token){
-    if (list->count>=list->capacity){
-        list->capacity*=2;
-        list->tokens = realloc(list->tokens,sizeof(Token)*list->capacity);
-        if(!list->tokens){
-            fprintf(stderr,"Failure to reallocate memory for token list");
+    if(list->count >= list->capacity && !reserveTokenList(list, list->capacity < 8 ? 8 : list->capacity * 2)){
+        list->failed = true;
+        return;
+    }
+    list->types[list->count] = (uint8_t)token.type;
+    list->offsets[list->count] = (uint32_t)(token.lexeme - list->source);
+    list->lengths[list->count] = (uint32_t)token.length;
+    if(token.type == TOKEN_NUMBER){
+        if(list->numberCount >= list->numberCapacity &&
+           !reserveTokenNumbers(list, list->numberCapacity < 8 ? 8 : list->numberCapacity * 2)){
+            list->failed = true;
             return;
         }
+        // decoded while the digits are still in cache, so nothing later reparses them
+        list->numbers[list->numberCount] = decodeNumber(token.lexeme, token.length);
+        list->numberTokens[list->numberCount] = (uint32_t)list->count;
+        list->numberCount++;
+    }
+    list->count++;
+}
+
+bool reserveTokenNumbers(TokenList* list, size_t capacity){
+    if(capacity <= list->numberCapacity) return true;
+    STAT_ALLOC(capacity * (sizeof(Value) + sizeof(uint32_t)));
+    Value* numbers = (Value*)realloc(list->numbers, capacity * sizeof(Value));
+    if(numbers) list->numbers = numbers;
+    uint32_t* numberTokens = (uint32_t*)realloc(list->numberTokens, capacity * sizeof(uint32_t));
+    if(numberTokens) list->numberTokens = numberTokens;
+    if(!numbers || !numberTokens){
+        fprintf(stderr,"Failure to reallocate memory for token numbers");
+        return false;
+    }
+    list->numberCapacity = capacity;
+    return true;
+}
+
+Value tokenNumberFrom(TokenList* list, size_t index, size_t* cursor){
+    size_t number = *cursor;
+    if(number >= list->numberCount || list->numberTokens[number] > index) number = 0;
+    while(number < list->numberCount && list->numberTokens[number] < index) number++;
+    *cursor = number;
+    if(number == list->numberCount || list->numberTokens[number] != index) return NIL_VAL;
+    return list->numbers[number];
+}
 
+// one pass of memchr over the source up to the end of the last token;
+// false, with no index, if memory runs out
+static bool buildLineIndex(TokenList* list){
+    if(list->count == 0){
+        list->indexed = true;
+        return true;
     }
-    list->tokens[list->count++] = token;
+    const char* end = list->source + list->offsets[list->count-1] + list->lengths[list->count-1];
+    size_t capacity = 0;
+    for(const char* p = list->source; (p = memchr(p, '\n', (size_t)(end - p))) != NULL; p++){
+        if(list->newlineCount >= capacity){
+            capacity = capacity < 64 ? 64 : capacity * 2;
+            STAT_ALLOC(capacity * sizeof(uint32_t));
+            uint32_t* newlines = (uint32_t*)realloc(list->newlines, capacity * sizeof(uint32_t));
+            if(!newlines){
+                fprintf(errorStream(), "Failure to allocate memory for line index\n");
+                free(list->newlines);
+                list->newlines = NULL;
+                list->newlineCount = 0;
+                return false;
+            }
+            list->newlines = newlines;
+        }
+        list->newlines[list->newlineCount++] = (uint32_t)(p - list->source);
+    }
+    list->indexed = true;
+    return true;
 }
 
-TokenList scanTokens(){
-    TokenList list;
-    initTokenList(&list);
-    while(*scanner.current!='\0'){
-        scanner.start = scanner.current;
-        char c = advance();
+// Counts the newlines before the token's end, which gives the line the
+// scanner was on when it made the token. Without an index they are
+// counted from the source, which is slower but still right.
+int tokenLineFrom(TokenList* list, size_t index, size_t* cursor){
+    uint32_t end = list->offsets[index] + list->lengths[index];
+    if(!list->indexed && !buildLineIndex(list)){
+        int line = list->firstLine;
+        const char* last = list->source + end;
+        for(const char* p = list->source; (p = memchr(p, '\n', (size_t)(last - p))) != NULL; p++) line++;
+        *cursor = 0;
+        return line;
+    }
+    size_t newline = *cursor;
+    if(newline > list->newlineCount || (newline > 0 && list->newlines[newline-1] >= end)){
+        newline = 0;
+    }
+    while(newline < list->newlineCount && list->newlines[newline] < end) newline++;
+    *cursor = newline;
+    return list->firstLine + (int)newline;
+}
+
+Scanner* currentScanner(){
+    return &scanner;
+}
+
+Token nextToken(){
+    Token token = scanToken(&scanner);
+    if(scanner.hadError) hadError = true;
+    return token;
+}
+
+// Scans and returns the next token, skipping whitespace, comments and
+// characters that are reported as errors. Returns TOKEN_EOF forever once
+// the end of the source (or a NUL byte) is reached.
+Token scanToken(Scanner* scanner){
+    for(;;){
+        scanner->start = scanner->current;
+        if(isAtEnd(scanner)){
+            return makeScannerToken(scanner, TOKEN_EOF, false);
+        }
+        char c = advance(scanner);
         switch(c){
             case '"':
-                string(&list);
-                break;
-            case '(': 
-                addToken(&list,makeToken(TOKEN_LEFT_PAREN, false));
-                break;
-            case ')': 
-                addToken(&list,makeToken(TOKEN_RIGHT_PAREN, false)); 
-                break;
-            case '{': 
-                addToken(&list,makeToken(TOKEN_LEFT_BRACE, false)); 
-                break;
-            case '}': 
-                addToken(&list,makeToken(TOKEN_RIGHT_BRACE, false)); 
-                break;
-            case ',': 
-                addToken(&list,makeToken(TOKEN_COMMA, false)); 
-                break;
-            case '.': 
-                addToken(&list,makeToken(TOKEN_DOT, false)); 
-                break;
-            case '-': 
-                addToken(&list,makeToken(TOKEN_MINUS, false)); 
-                break;
-            case '+': 
-                addToken(&list,makeToken(TOKEN_PLUS, false)); 
-                break;
-            case ';': 
-                addToken(&list,makeToken(TOKEN_SEMICOLON, false)); 
-                break;
-            case '*': 
-                addToken(&list,makeToken(TOKEN_STAR, false)); 
+                if(string(scanner)) return makeScannerToken(scanner, TOKEN_STRING, true);
                 break;
+            case '(': return makeScannerToken(scanner, TOKEN_LEFT_PAREN, false);
+            case ')': return makeScannerToken(scanner, TOKEN_RIGHT_PAREN, false);
+            case '{': return makeScannerToken(scanner, TOKEN_LEFT_BRACE, false);
+            case '}': return makeScannerToken(scanner, TOKEN_RIGHT_BRACE, false);
+            case ',': return makeScannerToken(scanner, TOKEN_COMMA, false);
+            case '.': return makeScannerToken(scanner, TOKEN_DOT, false);
+            case '-': return makeScannerToken(scanner, TOKEN_MINUS, false);
+            case '+': return makeScannerToken(scanner, TOKEN_PLUS, false);
+            case ';': return makeScannerToken(scanner, TOKEN_SEMICOLON, false);
+            case '*': return makeScannerToken(scanner, TOKEN_STAR, false);
             case '!':
-                match('=') ? addToken(&list,makeToken(TOKEN_BANG_EQUAL, false)): addToken(&list,makeToken(TOKEN_BANG, false));
-                break;
+                return makeScannerToken(scanner, match(scanner, '=') ? TOKEN_BANG_EQUAL : TOKEN_BANG, false);
             case '>':
-                match('=') ? addToken(&list,makeToken(TOKEN_GREATER_EQUAL, false)): addToken(&list,makeToken(TOKEN_GREATER, false));
-                break;
+                return makeScannerToken(scanner, match(scanner, '=') ? TOKEN_GREATER_EQUAL : TOKEN_GREATER, false);
             case '<':
-                match('=') ? addToken(&list,makeToken(TOKEN_LESS_EQUAL, false)): addToken(&list,makeToken(TOKEN_LESS, false));
-                break;
+                return makeScannerToken(scanner, match(scanner, '=') ? TOKEN_LESS_EQUAL : TOKEN_LESS, false);
             case '=':
-                match('=') ? addToken(&list,makeToken(TOKEN_EQUAL_EQUAL, false)): addToken(&list,makeToken(TOKEN_EQUAL, false));
-                break;
+                return makeScannerToken(scanner, match(scanner, '=') ? TOKEN_EQUAL_EQUAL : TOKEN_EQUAL, false);
             case '/':
-                if(match('/')){
-                    while(peek()!='\n' && peek()!='\0') advance();
+                if(match(scanner, '/')){
+                    scanner->current = scanner->kernels->findLineEnd(scanner->current, scanner->end);
+                    break;
                 }
-                else{
-                    addToken(&list,makeToken(TOKEN_SLASH, false));
-                }
-                break;
+                return makeScannerToken(scanner, TOKEN_SLASH, false);
             case '\r':
             case '\t':
             case ' ':
-                break;
             case '\n':
-                scanner.line++;
+                // skip the whole run, including the character just consumed
+                scanner->current = scanner->kernels->skipWhitespace(scanner->current-1, scanner->end, &scanner->line);
                 break;
             default:
                 if(isDigit(c)){
-                    number(&list);
+                    return number(scanner);
                 }
-                else if(isAlpha(c)){
-                    identifier(&list);
-                }
-                else{
-                    error(scanner.line,"Unexpected character.");
-                    hadError=true;
+                if(isAlpha(c)){
+                    return identifier(scanner);
                 }
+                error(scanner, "Unexpected character.");
         }
     }
-    scanner.start = scanner.current;
-    addToken(&list, makeToken(TOKEN_EOF, false));
-    freeTable(&keywordsTable);
-    return list;
 }
 
-void freeTokenList(TokenList* list){
-    for (int i = 0; i < list->count; i++) {
-        free((void*)list->tokens[i].lexeme);
+bool scanTokens(TokenList* tokens){
+    int threads = scanThreadCount();
+    TokenList list;
+    if((size_t)(scanner.end - scanner.current) > TOKEN_LIST_MAX_SOURCE){
+        // a lone EOF, so parsing the list stops at once
+        fprintf(scanner.errorOutput, "Source too large to scan into a token list\n");
+        scanner.hadError = true;
+        scanner.start = scanner.current;
+        initTokenList(&list, scanner.current, scanner.line);
+        addToken(&list, makeScannerToken(&scanner, TOKEN_EOF, false));
+    }
+    else if(threads > 1 && (size_t)(scanner.end - scanner.current) >= PARALLEL_SCAN_THRESHOLD){
+        list = scanTokensParallel(&scanner, threads);
+    }
+    else{
+        initTokenList(&list, scanner.current, scanner.line);
+        Token token;
+        do{
+            token = scanToken(&scanner);
+            addToken(&list, token);
+        } while(token.type!=TOKEN_EOF && !list.failed);
     }
-    free(list->tokens);
-    list->tokens= NULL;
-    list->count=0;
-    list->capacity=0;
+    if(list.failed){
+        // a list missing tokens would parse as a different program
+        fprintf(scanner.errorOutput, "Failed to scan the source into a token list\n");
+        freeTokenList(&list);
+        scanner.hadError = true;
+    }
+    STAT_ADD(STAT_TOKENS, list.count);
+    if(scanner.hadError) hadError = true;
+    *tokens = list;
+    return !list.failed;
 }
 
-static char peek(){
-    return *scanner.current;
+void freeTokenList(TokenList* list){
+    free(list->types);
+    free(list->offsets);
+    free(list->lengths);
+    free(list->newlines);
+    free(list->numbers);
+    free(list->numberTokens);
+    list->numbers = NULL;
+    list->numberTokens = NULL;
+    list->numberCount = 0;
+    list->numberCapacity = 0;
+    list->types = NULL;
+    list->offsets = NULL;
+    list->lengths = NULL;
+    list->newlines = NULL;
+    list->count = 0;
+    list->capacity = 0;
+    list->newlineCount = 0;
+    list->indexed = false;
 }
 
-static char peekNext(){
-    if (*(scanner.current + 1) == '\0') return '\0';
-    return *(scanner.current+1);
+void reportScanError(FILE* stream, int line, const char* message){
+    fprintf(stream,"[line %d] Error:  %s\n",line,message);
 }
 
-static char advance(){
-    return *scanner.current++;
+void freeScanErrors(ScanErrorList* errors){
+    free(errors->errors);
+    errors->errors = NULL;
+    errors->count = 0;
+    errors->capacity = 0;
 }
 
-static bool match(char expected){
-    if(peek()=='\0') return false;
-    if(peek()!=expected) return false;
-    scanner.current++;
-    return true;
+// chunks scanned on worker threads end at a newline rather than a NUL
+static bool isAtEnd(Scanner* scanner){
+    return scanner->current >= scanner->end || *scanner->current == '\0';
+}
+
+static char peek(Scanner* scanner){
+    return *scanner->current;
 }
 
-static void error(int line, char* message){
-    report(line,"",message);
+static char peekNext(Scanner* scanner){
+    if (*(scanner->current + 1) == '\0') return '\0';
+    return *(scanner->current+1);
 }
 
-static void report(int line, char* where, char* message){
-    fprintf(stderr,"[line %d] Error: %s %s\n",line,where,message);
-    hadError=true;
+static char advance(Scanner* scanner){
+    return *scanner->current++;
 }
 
-static void string(TokenList* list){
-    while(peek()!='"' && peek()!='\0'){
-        if(peek()=='\n') scanner.line++;
-        advance();
+static bool match(Scanner* scanner, char expected){
+    if(peek(scanner)=='\0') return false;
+    if(peek(scanner)!=expected) return false;
+    scanner->current++;
+    return true;
+}
+
+// errors are printed straight away unless the scanner is collecting them
+static void error(Scanner* scanner, char* message){
+    scanner->hadError = true;
+    ScanErrorList* errors = scanner->errors;
+    if(!errors){
+        reportScanError(scanner->errorOutput, scanner->line, message);
+        return;
     }
-    if(peek()=='\0'){
-        hadError=true;
-        error(scanner.line,"Unterminated String");
+    if(errors->count >= errors->capacity){
+        size_t capacity = errors->capacity < 8 ? 8 : errors->capacity * 2;
+        ScanError* grown = (ScanError*)realloc(errors->errors, sizeof(ScanError) * capacity);
+        if(!grown){
+            fprintf(stderr,"Failure to allocate memory for scan errors");
+            return;
+        }
+        errors->errors = grown;
+        errors->capacity = capacity;
     }
-    else{
-        advance();
-        addToken(list,makeToken(TOKEN_STRING, true));
+    errors->errors[errors->count++] = (ScanError){scanner->line, message};
+}
+
+// consumes a string body, returning false if it is unterminated
+static bool string(Scanner* scanner){
+    scanner->current = scanner->kernels->findStringEnd(scanner->current, scanner->end, &scanner->line);
+    if(isAtEnd(scanner)){
+        error(scanner, "Unterminated String");
+        return false;
     }
+    advance(scanner);
+    return true;
 }
 
-static void number(TokenList* list){
-    while(isDigit(peek()))advance();
-    if(peek()=='.' && isDigit(peekNext())){
-        advance();
-        while(isDigit(peek()))advance();
+static Token number(Scanner* scanner){
+    scanner->current = scanner->kernels->skipDigits(scanner->current, scanner->end);
+    if(peek(scanner)=='.' && isDigit(peekNext(scanner))){
+        advance(scanner);
+        scanner->current = scanner->kernels->skipDigits(scanner->current, scanner->end);
     }
-    addToken(list,makeToken(TOKEN_NUMBER, false));
+    return makeScannerToken(scanner, TOKEN_NUMBER, false);
 }
 
-static void identifier(TokenList* list){
-    while(isAlphaNumeric(peek()))advance();
-    size_t keyLength = scanner.current-scanner.start;
-    char* text = malloc(keyLength + 1);
-    if (!text) {
-        fprintf(stderr, "Failed to allocate memory for lexeme\n");
-        return;
+static Token identifier(Scanner* scanner){
+    scanner->current = scanner->kernels->skipIdentifier(scanner->current, scanner->end);
+    return makeScannerToken(scanner, identifierType(scanner), false);
+}
+
+// keywords are recognized with a trie keyed on the first one or two
+// characters, working directly on the source slice
+static TokenType identifierType(Scanner* scanner){
+    size_t length = scanner->current-scanner->start;
+    switch(scanner->start[0]){
+        case 'a': return checkKeyword(scanner, 1, 2, "nd", TOKEN_AND);
+        case 'c': return checkKeyword(scanner, 1, 4, "lass", TOKEN_CLASS);
+        case 'e': return checkKeyword(scanner, 1, 3, "lse", TOKEN_ELSE);
+        case 'f':
+            if(length > 1){
+                switch(scanner->start[1]){
+                    case 'a': return checkKeyword(scanner, 2, 3, "lse", TOKEN_FALSE);
+                    case 'o': return checkKeyword(scanner, 2, 1, "r", TOKEN_FOR);
+                    case 'u': return checkKeyword(scanner, 2, 1, "n", TOKEN_FUN);
+                }
+            }
+            break;
+        case 'i': return checkKeyword(scanner, 1, 1, "f", TOKEN_IF);
+        case 'n': return checkKeyword(scanner, 1, 2, "il", TOKEN_NIL);
+        case 'o': return checkKeyword(scanner, 1, 1, "r", TOKEN_OR);
+        case 'p': return checkKeyword(scanner, 1, 4, "rint", TOKEN_PRINT);
+        case 'r': return checkKeyword(scanner, 1, 5, "eturn", TOKEN_RETURN);
+        case 's': return checkKeyword(scanner, 1, 4, "uper", TOKEN_SUPER);
+        case 't':
+            if(length > 1){
+                switch(scanner->start[1]){
+                    case 'h': return checkKeyword(scanner, 2, 2, "is", TOKEN_THIS);
+                    case 'r': return checkKeyword(scanner, 2, 2, "ue", TOKEN_TRUE);
+                }
+            }
+            break;
+        case 'v': return checkKeyword(scanner, 1, 2, "ar", TOKEN_VAR);
+        case 'w': return checkKeyword(scanner, 1, 4, "hile", TOKEN_WHILE);
     }
-    memcpy(text, scanner.start, keyLength);
-    text[keyLength] = '\0';
-    void* tokenTypePtr = getEntry(&keywordsTable,text);
-    TokenType type = tokenTypePtr != NULL ? (TokenType)(uintptr_t)tokenTypePtr : TOKEN_IDENTIFIER;
-    addToken(list,makeToken(type,false));
-    free(text);
+    return TOKEN_IDENTIFIER;
+}
+
+static TokenType checkKeyword(Scanner* scanner, size_t start, size_t length, const char* rest, TokenType type){
+    if((size_t)(scanner->current-scanner->start) == start+length && memcmp(scanner->start+start, rest, length) == 0){
+        return type;
+    }
+    return TOKEN_IDENTIFIER;
 }
 
 static bool isDigit(char c){
@@ -261,7 +448,4 @@ static bool isDigit(char c){
 
 static bool isAlpha(char c){
     return (c>='A' && c<='Z') || (c>='a' && c<='z') || c=='_';
-}
-static bool isAlphaNumeric(char c){
-    return isDigit(c) || isAlpha(c);
 }
\ No newline at end of file
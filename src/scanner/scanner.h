@@ -2,8 +2,12 @@
 #define SCANNER_H
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "../value/value.h"
 
-extern bool hadError;
+// per thread, like the global scanner behind nextToken
+extern _Thread_local bool hadError;
 typedef enum TokenType{
     // Single-character tokens.
 TOKEN_LEFT_PAREN, TOKEN_RIGHT_PAREN,
@@ -26,37 +30,111 @@ TOKEN_EOF
 
 } TokenType;
 
+// lexeme points into the scanned source and is not NUL-terminated
 typedef struct{
     TokenType type;
+    int line;
     const char* lexeme;
     size_t length;
-    int line;
-
 } Token;
 
+// Tokens stored as columns, 9 bytes each against 24 for a Token. Offsets
+// are from source and lines are not stored: they are counted from an
+// index of the source's newlines, built the first time one is asked for.
 typedef struct{
-    Token* tokens;
+    const char* source;
+    // line of the byte at source
+    int firstLine;
+    uint8_t* types;
+    uint32_t* offsets;
+    uint32_t* lengths;
     size_t count;
     size_t capacity;
+    // set when a token could not be stored; the list is then incomplete
+    // and must not be parsed
+    bool failed;
+    // offsets of the newlines before the end of the last token
+    uint32_t* newlines;
+    size_t newlineCount;
+    bool indexed;
+    // number tokens' values, decoded as they are added, and the tokens
+    // they belong to, in token order
+    Value* numbers;
+    uint32_t* numberTokens;
+    size_t numberCount;
+    size_t numberCapacity;
 } TokenList;
 
+// offsets are 32 bits, so longer sources can only be parsed as a stream
+#define TOKEN_LIST_MAX_SOURCE UINT32_MAX
+
+typedef struct{
+    int line;
+    const char* message;
+} ScanError;
+
+typedef struct{
+    ScanError* errors;
+    size_t count;
+    size_t capacity;
+} ScanErrorList;
+
 typedef struct{
     const char* start;
     const char* current;
+    // one past the last byte; the source must still be NUL-terminated
+    const char* end;
     int line;
+    // when set, errors are collected here instead of printed
+    ScanErrorList* errors;
+    // where errors are printed; the calling thread's errorStream() by default
+    FILE* errorOutput;
+    bool hadError;
+    const struct ScanKernels* kernels;
 
 } Scanner;
 
-// token list for storing tokens
-void initTokenList(TokenList* list);
+// sources at least this large are scanned on several threads
+#define PARALLEL_SCAN_THRESHOLD (4u << 20)
+
+// token list for storing tokens; the tokens' lexemes must point into source
+void initTokenList(TokenList* list, const char* source, int firstLine);
+bool reserveTokenList(TokenList* list, size_t capacity);
 Token makeToken(TokenType type, bool trimQuotes);
+// sets failed if memory runs out
 void addToken(TokenList* list, Token token);
+// the line of a token, walking the line index forward from *cursor (start
+// it at 0), which is cheaper when tokens are visited in order
+int tokenLineFrom(TokenList* list, size_t index, size_t* cursor);
+bool reserveTokenNumbers(TokenList* list, size_t capacity);
+// the value of a number token, walking the number column from *cursor
+// (start it at 0) the same way
+Value tokenNumberFrom(TokenList* list, size_t index, size_t* cursor);
 void freeTokenList(TokenList* list);
 
-// scanner functions
-void initScanner(const char* source);
-void initKeywordsTable();
-TokenList scanTokens();
+// the calling thread's scanner; errors also set hadError
+void initScanner(const char* source, size_t length);
+Token nextToken();
+// Scans the whole source up front into list; the parser pulls tokens with
+// nextToken instead. False, with list empty, if memory runs out.
+bool scanTokens(TokenList* list);
+
+// lower-level entry points for scanners other than the global one
+void initScannerState(Scanner* scanner, const char* source, size_t length);
+Token scanToken(Scanner* scanner);
+// prints one error in the scanner's format
+void reportScanError(FILE* stream, int line, const char* message);
+// the scanner behind initScanner and nextToken
+Scanner* currentScanner();
+void freeScanErrors(ScanErrorList* errors);
+
+// Splits the rest of scanner's source at newlines outside strings and
+// comments and scans the pieces on up to threadCount threads. Tokens,
+// line numbers and errors match a serial scan exactly. The list is marked
+// failed if a piece or the merge runs out of memory.
+TokenList scanTokensParallel(Scanner* scanner, int threadCount);
+// LOX_SCAN_THREADS if set, otherwise the number of online CPUs
+int scanThreadCount();
 
 
 #endif
\ No newline at end of file
@@ -0,0 +1,100 @@
+#include "source.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../output/output.h"
+
+#define READ_CHUNK_SIZE (64 * 1024)
+
+// Maps the file into a reservation one byte larger than the file, rounded
+// up to whole pages. The kernel zero-fills the mapping past end of file,
+// and when the file ends exactly on a page boundary the anonymous page
+// after it supplies the terminator, so no copy is needed.
+static bool mapSource(int fd, size_t length, Source* source){
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    size_t mappedSize = (length + 1 + pageSize - 1) / pageSize * pageSize;
+    char* reserved = (char*)mmap(NULL, mappedSize, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(reserved == MAP_FAILED){
+        return false;
+    }
+    char* data = (char*)mmap(reserved, length, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0);
+    if(data == MAP_FAILED){
+        munmap(reserved, mappedSize);
+        return false;
+    }
+    // the scanner reads the file front to back exactly once
+    madvise(data, length, MADV_SEQUENTIAL);
+    source->data = data;
+    source->length = length;
+    source->mappedSize = mappedSize;
+    return true;
+}
+
+// fallback for pipes, character devices and anything mmap refuses
+static bool readSource(int fd, Source* source){
+    size_t capacity = READ_CHUNK_SIZE;
+    size_t length = 0;
+    char* buffer = (char*)malloc(capacity + 1);
+    if(!buffer){
+        fprintf(errorStream(), "Failed to allocate memory for source buffer\n");
+        return false;
+    }
+    for(;;){
+        if(length == capacity){
+            capacity *= 2;
+            char* grown = (char*)realloc(buffer, capacity + 1);
+            if(!grown){
+                fprintf(errorStream(), "Failed to reallocate memory for source buffer\n");
+                free(buffer);
+                return false;
+            }
+            buffer = grown;
+        }
+        ssize_t bytesRead = read(fd, buffer + length, capacity - length);
+        if(bytesRead < 0){
+            fprintf(errorStream(), "Error reading file into the buffer\n");
+            free(buffer);
+            return false;
+        }
+        if(bytesRead == 0) break;
+        length += (size_t)bytesRead;
+    }
+    buffer[length] = '\0';
+    source->data = buffer;
+    source->length = length;
+    source->mappedSize = 0;
+    return true;
+}
+
+bool loadSource(const char* path, Source* source){
+    int fd = open(path, O_RDONLY);
+    if(fd < 0){
+        fprintf(errorStream(), "Failed to open file at \"%s\"\n", path);
+        return false;
+    }
+    struct stat info;
+    bool loaded = false;
+    if(fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0){
+        loaded = mapSource(fd, (size_t)info.st_size, source);
+    }
+    if(!loaded){
+        loaded = readSource(fd, source);
+    }
+    close(fd);
+    return loaded;
+}
+
+void freeSource(Source* source){
+    if(source->mappedSize){
+        munmap((void*)source->data, source->mappedSize);
+    }
+    else{
+        free((void*)source->data);
+    }
+    source->data = NULL;
+    source->length = 0;
+    source->mappedSize = 0;
+}
@@ -0,0 +1,19 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// A script loaded for scanning. data is always followed by a NUL byte.
+// Regular files are memory-mapped, everything else is read into the heap.
+typedef struct{
+    const char* data;
+    size_t length;
+    // size of the mapping, or 0 when data was read into the heap
+    size_t mappedSize;
+} Source;
+
+bool loadSource(const char* path, Source* source);
+void freeSource(Source* source);
+
+#endif
@@ -0,0 +1,94 @@
+#include "stats.h"
+#include <string.h>
+#include <time.h>
+
+_Thread_local Stats stats;
+bool statsTiming = false;
+
+static const char* phaseNames[PHASE_COUNT] = {
+    "load", "scan", "parse", "optimize", "evaluate", "teardown"
+};
+
+static const char* counterNames[STAT_COUNT] = {
+    "tokens", "nodes", "allocations", "bytes", "lookups", "inserts", "probes", "resizes"
+};
+
+static double seconds(clockid_t clock){
+    struct timespec now;
+    clock_gettime(clock, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+void resetStats(){
+    memset(&stats, 0, sizeof(stats));
+    stats.wallStart = seconds(CLOCK_MONOTONIC);
+    stats.cpuStart = seconds(CLOCK_THREAD_CPUTIME_ID);
+}
+
+void enterPhase(StatsPhase phase){
+    double wall = seconds(CLOCK_MONOTONIC);
+    double cpu = seconds(CLOCK_THREAD_CPUTIME_ID);
+    stats.wall[stats.phase] += wall - stats.wallStart;
+    stats.cpu[stats.phase] += cpu - stats.cpuStart;
+    stats.phase = phase;
+    stats.wallStart = wall;
+    stats.cpuStart = cpu;
+}
+
+void collectStats(Stats* into){
+    *into = stats;
+    // a new thread's CPU clock starts at zero, as cpuStart does
+    if(statsTiming) into->cpu[into->phase] += seconds(CLOCK_THREAD_CPUTIME_ID) - stats.cpuStart;
+}
+
+void mergeStats(const Stats* helper){
+    for(int phase = 0; phase < PHASE_COUNT; phase++){
+        for(int counter = 0; counter < STAT_COUNT; counter++){
+            stats.counters[stats.phase][counter] += helper->counters[phase][counter];
+        }
+        stats.cpu[stats.phase] += helper->cpu[phase];
+    }
+    for(int i = 0; i < PROBE_BUCKETS; i++) stats.probeLengths[i] += helper->probeLengths[i];
+}
+
+static void reportText(FILE* file){
+    fprintf(file, "--- Stats ---\n%-9s %10s %10s", "phase", "wall ms", "cpu ms");
+    for(int i=0;i<STAT_COUNT;i++) fprintf(file, " %11s", counterNames[i]);
+    fprintf(file, "\n");
+    for(int phase=0;phase<PHASE_COUNT;phase++){
+        fprintf(file, "%-9s %10.3f %10.3f", phaseNames[phase], stats.wall[phase] * 1e3, stats.cpu[phase] * 1e3);
+        for(int i=0;i<STAT_COUNT;i++) fprintf(file, " %11llu", (unsigned long long)stats.counters[phase][i]);
+        fprintf(file, "\n");
+    }
+    fprintf(file, "groups probed:");
+    for(int i=0;i<PROBE_BUCKETS;i++){
+        if(stats.probeLengths[i]){
+            fprintf(file, " %d%s=%llu", i + 1, i == PROBE_BUCKETS - 1 ? "+" : "", (unsigned long long)stats.probeLengths[i]);
+        }
+    }
+    fprintf(file, "\n");
+}
+
+static void reportJson(FILE* file){
+    fprintf(file, "{\"phases\":{");
+    for(int phase=0;phase<PHASE_COUNT;phase++){
+        fprintf(file, "%s\"%s\":{\"wall_ms\":%.3f,\"cpu_ms\":%.3f", phase ? "," : "",
+                phaseNames[phase], stats.wall[phase] * 1e3, stats.cpu[phase] * 1e3);
+        for(int i=0;i<STAT_COUNT;i++){
+            fprintf(file, ",\"%s\":%llu", counterNames[i], (unsigned long long)stats.counters[phase][i]);
+        }
+        fprintf(file, "}");
+    }
+    fprintf(file, "},\"probe_lengths\":[");
+    for(int i=0;i<PROBE_BUCKETS;i++){
+        fprintf(file, "%s%llu", i ? "," : "", (unsigned long long)stats.probeLengths[i]);
+    }
+    fprintf(file, "]}\n");
+}
+
+// closes the current phase first, so the report includes it
+void reportStats(FILE* file, bool json){
+    enterPhase(stats.phase);
+    if(json) reportJson(file);
+    else reportText(file);
+}
@@ -0,0 +1,84 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// What --stats reports: wall and CPU time per phase of a run, and counters
+// that the hooks below attribute to whichever phase is current. Built with
+// -DLOX_STATS=OFF the hooks expand to nothing and cost nothing.
+typedef enum{
+    PHASE_LOAD,
+    PHASE_SCAN,
+    PHASE_PARSE,
+    PHASE_OPTIMIZE,
+    PHASE_EVALUATE,
+    PHASE_TEARDOWN,
+    PHASE_COUNT
+} StatsPhase;
+
+typedef enum{
+    STAT_TOKENS,
+    STAT_NODES,
+    STAT_ALLOCATIONS,   // arena and heap allocations
+    STAT_BYTES,
+    STAT_LOOKUPS,       // Table reads
+    STAT_INSERTS,       // Table writes
+    STAT_PROBES,        // groups inspected by either
+    STAT_RESIZES,       // Table rehashes
+    STAT_COUNT
+} StatsCounter;
+
+// the last bucket also counts longer probe sequences
+#define PROBE_BUCKETS 16
+
+typedef struct{
+    double wall[PHASE_COUNT];
+    double cpu[PHASE_COUNT];
+    uint64_t counters[PHASE_COUNT][STAT_COUNT];
+    // lookups and inserts by number of groups probed, starting at one
+    uint64_t probeLengths[PROBE_BUCKETS];
+    StatsPhase phase;
+    double wallStart;
+    double cpuStart;
+} Stats;
+
+// per thread, so batch workers count their own scripts; helper threads,
+// like the parallel scan's, hand theirs back to the thread that joins them
+extern _Thread_local Stats stats;
+
+// Phases change around every statement of a program, and timing a change
+// takes two clock reads, so clocks are only read once this is set;
+// counters are attributed to phases either way.
+extern bool statsTiming;
+
+void resetStats();
+// ends the current phase's timing and starts the given one's
+void enterPhase(StatsPhase phase);
+void reportStats(FILE* file, bool json);
+// what the calling helper thread has counted, and the CPU time it has used
+void collectStats(Stats* into);
+// adds a helper's counters, from every phase, and CPU time to the current phase
+void mergeStats(const Stats* helper);
+
+#ifdef LOX_STATS
+#define STATS_RESET() resetStats()
+#define STATS_PHASE(next) (statsTiming ? enterPhase(next) : (void)(stats.phase = (next)))
+#define STAT_ADD(counter, amount) (stats.counters[stats.phase][counter] += (amount))
+#define STAT_ALLOC(bytes) (STAT_ADD(STAT_ALLOCATIONS, 1), STAT_ADD(STAT_BYTES, (bytes)))
+#define STAT_PROBE(groups) (STAT_ADD(STAT_PROBES, (groups)), \
+    stats.probeLengths[(groups) < PROBE_BUCKETS ? (groups) - 1 : PROBE_BUCKETS - 1]++)
+#define STATS_COLLECT(into) collectStats(into)
+#define STATS_MERGE(helper) mergeStats(helper)
+#else
+#define STATS_RESET() ((void)0)
+#define STATS_PHASE(phase) ((void)0)
+#define STAT_ADD(counter, amount) ((void)0)
+#define STAT_ALLOC(bytes) ((void)0)
+#define STAT_PROBE(groups) ((void)0)
+#define STATS_COLLECT(into) ((void)0)
+#define STATS_MERGE(helper) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef ARITH_H
+#define ARITH_H
+
+#include "value.h"
+#include "../intern/intern.h"
+
+// What the operators do, shared by the VM, the flat evaluator and the
+// optimizer's folding so that all three agree. Each stores its result
+// and returns ARITH_OK, or returns the error the runtime reports.
+// Equality and truthiness are valuesEqual and isFalsey.
+typedef enum{
+    ARITH_OK,
+    ARITH_NOT_NUMBER,
+    ARITH_NOT_NUMBERS,
+    ARITH_NOT_NUMBERS_OR_STRINGS,
+    ARITH_OUT_OF_MEMORY
+} ArithResult;
+
+static inline const char* arithMessage(ArithResult result){
+    switch(result){
+        case ARITH_NOT_NUMBER: return "Operand must be a number.";
+        case ARITH_NOT_NUMBERS: return "Operands must be numbers.";
+        case ARITH_NOT_NUMBERS_OR_STRINGS: return "Operands must be two numbers or two strings.";
+        case ARITH_OUT_OF_MEMORY: return "Out of memory.";
+        default: return "";
+    }
+}
+
+static inline ArithResult negateValue(Value a, Value* result){
+    if(IS_INT(a)) *result = integerValue(-AS_INT(a));
+    else if(IS_FLOAT(a)) *result = FLOAT_VAL(-AS_FLOAT(a));
+    else return ARITH_NOT_NUMBER;
+    return ARITH_OK;
+}
+
+// two ints stay an int unless the result leaves the boxed range; any
+// float makes the result a float
+#define ARITH_NUMERIC(name, integerOp, op) \
+    static inline ArithResult name(Value a, Value b, Value* result){ \
+        if(IS_INT(a) && IS_INT(b)) *result = integerOp(AS_INT(a), AS_INT(b)); \
+        else if(IS_NUMBER(a) && IS_NUMBER(b)) *result = FLOAT_VAL(AS_NUMBER(a) op AS_NUMBER(b)); \
+        else return ARITH_NOT_NUMBERS; \
+        return ARITH_OK; \
+    }
+
+ARITH_NUMERIC(subtractValues, subtractIntegers, -)
+ARITH_NUMERIC(multiplyValues, multiplyIntegers, *)
+
+// numbers add, strings concatenate into strings
+static inline ArithResult addValues(InternTable* strings, Value a, Value b, Value* result){
+    if(IS_STRING(a) && IS_STRING(b)){
+        ObjString* string = internConcatenationIn(strings, AS_STRING(a), AS_STRING(b));
+        if(!string) return ARITH_OUT_OF_MEMORY;
+        *result = OBJ_VAL(string);
+        return ARITH_OK;
+    }
+    if(!IS_NUMBER(a) || !IS_NUMBER(b)) return ARITH_NOT_NUMBERS_OR_STRINGS;
+    if(IS_INT(a) && IS_INT(b)) *result = addIntegers(AS_INT(a), AS_INT(b));
+    else *result = FLOAT_VAL(AS_NUMBER(a) + AS_NUMBER(b));
+    return ARITH_OK;
+}
+
+// division always produces a float
+static inline ArithResult divideValues(Value a, Value b, Value* result){
+    if(!IS_NUMBER(a) || !IS_NUMBER(b)) return ARITH_NOT_NUMBERS;
+    *result = FLOAT_VAL(AS_NUMBER(a) / AS_NUMBER(b));
+    return ARITH_OK;
+}
+
+// ints compare exactly rather than through doubles
+#define ARITH_COMPARISON(name, op) \
+    static inline ArithResult name(Value a, Value b, Value* result){ \
+        if(IS_INT(a) && IS_INT(b)) *result = BOOL_VAL(AS_INT(a) op AS_INT(b)); \
+        else if(IS_NUMBER(a) && IS_NUMBER(b)) *result = BOOL_VAL(AS_NUMBER(a) op AS_NUMBER(b)); \
+        else return ARITH_NOT_NUMBERS; \
+        return ARITH_OK; \
+    }
+
+ARITH_COMPARISON(greaterValues, >)
+ARITH_COMPARISON(greaterEqualValues, >=)
+ARITH_COMPARISON(lessValues, <)
+ARITH_COMPARISON(lessEqualValues, <=)
+
+#undef ARITH_NUMERIC
+#undef ARITH_COMPARISON
+
+#endif
@@ -0,0 +1,66 @@
+#include "value.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "../output/output.h"
+
+void initValueArray(ValueArray* array){
+    array->values = NULL;
+    array->count = 0;
+    array->capacity = 0;
+}
+
+bool writeValueArray(ValueArray* array, Value value){
+    if(array->count >= array->capacity){
+        size_t capacity = array->capacity < 8 ? 8 : array->capacity * 2;
+        Value* values = (Value*)realloc(array->values, sizeof(Value) * capacity);
+        if(!values){
+            fprintf(errorStream(), "Failure to reallocate memory for value array\n");
+            return false;
+        }
+        array->values = values;
+        array->capacity = capacity;
+    }
+    array->values[array->count++] = value;
+    return true;
+}
+
+void freeValueArray(ValueArray* array){
+    free(array->values);
+    initValueArray(array);
+}
+
+bool isFalsey(Value value){
+    return IS_NIL(value) || value == FALSE_VAL;
+}
+
+bool valuesEqual(Value a, Value b){
+    if(IS_INT(a) && IS_INT(b)) return a == b;
+    // integers and floats compare by numeric value
+    if(IS_NUMBER(a) && IS_NUMBER(b)) return AS_NUMBER(a) == AS_NUMBER(b);
+    // strings are interned, so everything else compares by bits
+    return a == b;
+}
+
+void displayValue(Value value){
+    displayValueTo(outputStream(), value);
+}
+
+void displayValueTo(FILE* stream, Value value){
+    if(IS_BOOL(value)){
+        fprintf(stream, "%s", AS_BOOL(value) ? "true" : "false");
+    }
+    else if(IS_NIL(value)){
+        fputs("nil", stream);
+    }
+    else if(IS_INT(value)){
+        fprintf(stream, "%" PRId64, AS_INT(value));
+    }
+    else if(IS_FLOAT(value)){
+        fprintf(stream, "%f", AS_FLOAT(value));
+    }
+    else if(IS_STRING(value)){
+        fputs(AS_STRING(value)->chars, stream);
+    }
+}
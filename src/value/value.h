@@ -0,0 +1,109 @@
+#ifndef VALUE_H
+#define VALUE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "../object/object.h"
+
+// Values are NaN-boxed into 64 bits. Any double that is not a quiet NaN
+// with the QNAN bits below set is stored as is. Everything else lives in
+// the NaN payload:
+//   nil/false/true  QNAN | 1, 2, 3
+//   integers        QNAN | INT_TAG | 48-bit two's complement payload
+//   objects         SIGN_BIT | QNAN | 48-bit pointer
+typedef uint64_t Value;
+
+#define SIGN_BIT ((uint64_t)0x8000000000000000)
+#define QNAN ((uint64_t)0x7ffc000000000000)
+#define INT_TAG ((uint64_t)0x0001000000000000)
+#define TAG_MASK (SIGN_BIT | QNAN | (uint64_t)0x0003000000000000)
+#define PAYLOAD_MASK ((uint64_t)0x0000ffffffffffff)
+
+#define TAG_NIL 1
+#define TAG_FALSE 2
+#define TAG_TRUE 3
+
+// integers are exact in this range, results outside it become floats
+#define INT_VALUE_MIN (-(INT64_C(1) << 47))
+#define INT_VALUE_MAX ((INT64_C(1) << 47) - 1)
+
+#define IS_NIL(value) ((value) == NIL_VAL)
+#define IS_BOOL(value) (((value) | 1) == TRUE_VAL)
+#define IS_INT(value) (((value) & TAG_MASK) == (QNAN | INT_TAG))
+#define IS_FLOAT(value) (((value) & QNAN) != QNAN)
+#define IS_NUMBER(value) (IS_FLOAT(value) || IS_INT(value))
+#define IS_OBJ(value) (((value) & (QNAN | SIGN_BIT)) == (QNAN | SIGN_BIT))
+#define IS_STRING(value) (IS_OBJ(value) && AS_OBJ(value)->type == OBJ_STRING)
+
+#define AS_BOOL(value) ((value) == TRUE_VAL)
+#define AS_INT(value) (((int64_t)((value) << 16)) >> 16)
+#define AS_FLOAT(value) valueToFloat(value)
+#define AS_NUMBER(value) (IS_INT(value) ? (double)AS_INT(value) : AS_FLOAT(value))
+#define AS_OBJ(value) ((Obj*)(uintptr_t)((value) & ~(SIGN_BIT | QNAN)))
+#define AS_STRING(value) ((ObjString*)AS_OBJ(value))
+
+#define NIL_VAL ((Value)(QNAN | TAG_NIL))
+#define FALSE_VAL ((Value)(QNAN | TAG_FALSE))
+#define TRUE_VAL ((Value)(QNAN | TAG_TRUE))
+#define BOOL_VAL(value) ((value) ? TRUE_VAL : FALSE_VAL)
+#define INT_VAL(value) ((Value)(QNAN | INT_TAG | ((uint64_t)(int64_t)(value) & PAYLOAD_MASK)))
+#define FLOAT_VAL(value) floatToValue(value)
+#define OBJ_VAL(object) ((Value)(SIGN_BIT | QNAN | (uint64_t)(uintptr_t)(object)))
+
+static inline double valueToFloat(Value value){
+    double number;
+    memcpy(&number, &value, sizeof(Value));
+    return number;
+}
+
+static inline Value floatToValue(double number){
+    Value value;
+    memcpy(&value, &number, sizeof(double));
+    return value;
+}
+
+// boxes an integer, falling back to a float when it does not fit
+static inline Value integerValue(int64_t number){
+    if(number < INT_VALUE_MIN || number > INT_VALUE_MAX) return FLOAT_VAL((double)number);
+    return INT_VAL(number);
+}
+
+// integer arithmetic shared by the VM and the optimizer; results that
+// leave the boxed int range are promoted to floats
+static inline Value addIntegers(int64_t a, int64_t b){
+    return integerValue(a + b);
+}
+
+static inline Value subtractIntegers(int64_t a, int64_t b){
+    return integerValue(a - b);
+}
+
+static inline Value multiplyIntegers(int64_t a, int64_t b){
+    // both operands fit in 48 bits, so if the rounded product is in range
+    // the exact one cannot overflow int64
+    double product = (double)a * (double)b;
+    if(product < INT_VALUE_MIN || product > INT_VALUE_MAX) return FLOAT_VAL(product);
+    return integerValue(a * b);
+}
+
+typedef struct{
+    Value* values;
+    size_t count;
+    size_t capacity;
+} ValueArray;
+
+void initValueArray(ValueArray* array);
+// false if memory runs out
+bool writeValueArray(ValueArray* array, Value value);
+void freeValueArray(ValueArray* array);
+
+bool isFalsey(Value value);
+bool valuesEqual(Value a, Value b);
+// prints to the calling thread's outputStream()
+void displayValue(Value value);
+void displayValueTo(FILE* stream, Value value);
+
+#endif
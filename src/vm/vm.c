@@ -0,0 +1,179 @@
+#include "vm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include "../intern/intern.h"
+#include "../value/arith.h"
+#include "../output/output.h"
+
+// computed goto dispatch needs the GNU labels-as-values extension
+#if defined(__GNUC__) || defined(__clang__)
+#define COMPUTED_GOTO
+#endif
+
+void initVM(VM* vm){
+    vm->stack = NULL;
+    vm->stackCapacity = 0;
+    vm->strings = currentInternTable();
+    vm->errorOutput = errorStream();
+}
+
+void freeVM(VM* vm){
+    free(vm->stack);
+    initVM(vm);
+}
+
+static bool reserveStack(VM* vm, size_t size){
+    if(size <= vm->stackCapacity) return true;
+    Value* stack = (Value*)realloc(vm->stack, sizeof(Value) * size);
+    if(!stack){
+        fprintf(stderr, "Failure to reallocate memory for VM stack");
+        return false;
+    }
+    vm->stack = stack;
+    vm->stackCapacity = size;
+    return true;
+}
+
+static void runtimeError(VM* vm, Chunk* chunk, const uint8_t* ip, const char* message){
+    size_t offset = (size_t)(ip - chunk->code - 1);
+    fprintf(vm->errorOutput, "[line %d] Runtime error: %s\n", getLine(chunk, offset), message);
+}
+
+InterpretResult runChunk(VM* vm, Chunk* chunk, Value* result){
+    // its bytecode is missing whatever could not be stored
+    if(chunk->failed) return INTERPRET_RUNTIME_ERROR;
+    if(!reserveStack(vm, chunk->maxStack + 1)) return INTERPRET_RUNTIME_ERROR;
+    // the compiler sized the stack, so pushes need no bounds checks
+    Value* stackTop = vm->stack;
+    const uint8_t* ip = chunk->code;
+    Value* constants = chunk->constants.values;
+
+#define READ_BYTE() (*ip++)
+#define PUSH(value) (*stackTop++ = (value))
+#define POP() (*--stackTop)
+#define PEEK(distance) (stackTop[-1 - (distance)])
+#define RUNTIME_ERROR(message) \
+    do{ runtimeError(vm, chunk, ip, message); return INTERPRET_RUNTIME_ERROR; }while(0)
+// replaces the top two values with the operation's result
+#define BINARY_OP(operation) \
+    do{ \
+        Value b = POP(); \
+        ArithResult status = operation(PEEK(0), b, &PEEK(0)); \
+        if(status != ARITH_OK) RUNTIME_ERROR(arithMessage(status)); \
+    }while(0)
+
+#ifdef COMPUTED_GOTO
+    static void* dispatchTable[] = {
+        [OP_CONSTANT] = &&op_constant,
+        [OP_CONSTANT_LONG] = &&op_constant_long,
+        [OP_NIL] = &&op_nil,
+        [OP_TRUE] = &&op_true,
+        [OP_FALSE] = &&op_false,
+        [OP_EQUAL] = &&op_equal,
+        [OP_NOT_EQUAL] = &&op_not_equal,
+        [OP_GREATER] = &&op_greater,
+        [OP_GREATER_EQUAL] = &&op_greater_equal,
+        [OP_LESS] = &&op_less,
+        [OP_LESS_EQUAL] = &&op_less_equal,
+        [OP_ADD] = &&op_add,
+        [OP_SUBTRACT] = &&op_subtract,
+        [OP_MULTIPLY] = &&op_multiply,
+        [OP_DIVIDE] = &&op_divide,
+        [OP_NOT] = &&op_not,
+        [OP_NEGATE] = &&op_negate,
+        [OP_RETURN] = &&op_return,
+    };
+#define DISPATCH() goto *dispatchTable[READ_BYTE()]
+#define CASE(label, opcode) label
+#else
+#define DISPATCH() goto dispatch
+#define CASE(label, opcode) case opcode
+#endif
+
+#ifdef COMPUTED_GOTO
+    DISPATCH();
+#else
+dispatch:
+    switch(READ_BYTE()){
+#endif
+    CASE(op_constant, OP_CONSTANT): {
+        PUSH(constants[READ_BYTE()]);
+        DISPATCH();
+    }
+    CASE(op_constant_long, OP_CONSTANT_LONG): {
+        size_t index = ip[0] | (ip[1] << 8) | (ip[2] << 16);
+        ip += 3;
+        PUSH(constants[index]);
+        DISPATCH();
+    }
+    CASE(op_nil, OP_NIL):
+        PUSH(NIL_VAL);
+        DISPATCH();
+    CASE(op_true, OP_TRUE):
+        PUSH(BOOL_VAL(true));
+        DISPATCH();
+    CASE(op_false, OP_FALSE):
+        PUSH(BOOL_VAL(false));
+        DISPATCH();
+    CASE(op_equal, OP_EQUAL): {
+        Value b = POP();
+        PEEK(0) = BOOL_VAL(valuesEqual(PEEK(0), b));
+        DISPATCH();
+    }
+    CASE(op_not_equal, OP_NOT_EQUAL): {
+        Value b = POP();
+        PEEK(0) = BOOL_VAL(!valuesEqual(PEEK(0), b));
+        DISPATCH();
+    }
+    CASE(op_greater, OP_GREATER):
+        BINARY_OP(greaterValues);
+        DISPATCH();
+    CASE(op_greater_equal, OP_GREATER_EQUAL):
+        BINARY_OP(greaterEqualValues);
+        DISPATCH();
+    CASE(op_less, OP_LESS):
+        BINARY_OP(lessValues);
+        DISPATCH();
+    CASE(op_less_equal, OP_LESS_EQUAL):
+        BINARY_OP(lessEqualValues);
+        DISPATCH();
+    CASE(op_add, OP_ADD): {
+        Value b = POP();
+        ArithResult status = addValues(vm->strings, PEEK(0), b, &PEEK(0));
+        if(status != ARITH_OK) RUNTIME_ERROR(arithMessage(status));
+        DISPATCH();
+    }
+    CASE(op_subtract, OP_SUBTRACT):
+        BINARY_OP(subtractValues);
+        DISPATCH();
+    CASE(op_multiply, OP_MULTIPLY):
+        BINARY_OP(multiplyValues);
+        DISPATCH();
+    CASE(op_divide, OP_DIVIDE):
+        BINARY_OP(divideValues);
+        DISPATCH();
+    CASE(op_not, OP_NOT):
+        PEEK(0) = BOOL_VAL(isFalsey(PEEK(0)));
+        DISPATCH();
+    CASE(op_negate, OP_NEGATE): {
+        ArithResult status = negateValue(PEEK(0), &PEEK(0));
+        if(status != ARITH_OK) RUNTIME_ERROR(arithMessage(status));
+        DISPATCH();
+    }
+    CASE(op_return, OP_RETURN):
+        *result = stackTop > vm->stack ? POP() : NIL_VAL;
+        return INTERPRET_OK;
+#ifndef COMPUTED_GOTO
+    }
+    return INTERPRET_RUNTIME_ERROR;
+#endif
+
+#undef READ_BYTE
+#undef PUSH
+#undef POP
+#undef PEEK
+#undef RUNTIME_ERROR
+#undef BINARY_OP
+#undef DISPATCH
+#undef CASE
+}
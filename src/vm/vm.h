@@ -0,0 +1,29 @@
+#ifndef VM_H
+#define VM_H
+
+#include <stdio.h>
+#include "../chunk/chunk.h"
+#include "../intern/intern.h"
+
+typedef enum{
+    INTERPRET_OK,
+    INTERPRET_RUNTIME_ERROR
+} InterpretResult;
+
+typedef struct{
+    Value* stack;
+    size_t stackCapacity;
+    // where strings built at runtime are interned
+    InternTable* strings;
+    // where runtime errors are printed
+    FILE* errorOutput;
+} VM;
+
+// strings defaults to the calling thread's intern table and errorOutput to
+// its errorStream()
+void initVM(VM* vm);
+void freeVM(VM* vm);
+// runs a compiled chunk; a chunk can be run any number of times
+InterpretResult runChunk(VM* vm, Chunk* chunk, Value* result);
+
+#endif
@@ -0,0 +1,75 @@
+// Runs two contexts at once on two threads through the shared library's
+// exported API, and checks that each one's results and errors reach only
+// its own streams.
+#include <lox.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ROUNDS 500
+
+typedef struct{
+    const char* source;
+    LoxResult result;
+    // what one run writes to the context's output and error streams
+    const char* output;
+    const char* errors;
+    int failures;
+} Case;
+
+static Case cases[] = {
+    {"1 + 2;\n\"a\" + \"b\" == \"ab\";", LOX_OK, "3\ntrue\n", "", 0},
+    {"2 * 3;\n-\"x\";\n4;", LOX_RUNTIME_ERROR, "6\n", "[line 2] Runtime error: Operand must be a number.\n", 0},
+};
+
+// true if stream holds exactly ROUNDS copies of expected
+static bool holdsRounds(FILE* stream, const char* expected){
+    size_t length = strlen(expected);
+    char* text = (char*)malloc(length + 1);
+    if(!text) return false;
+    rewind(stream);
+    bool ok = true;
+    for(int i = 0; ok && i < ROUNDS; i++){
+        ok = fread(text, 1, length, stream) == length && memcmp(text, expected, length) == 0;
+    }
+    free(text);
+    return ok && fgetc(stream) == EOF;
+}
+
+static void* runCase(void* argument){
+    Case* test = (Case*)argument;
+    LoxContext* context = loxNewContext();
+    FILE* output = tmpfile();
+    FILE* errors = tmpfile();
+    if(!context || !output || !errors){
+        test->failures++;
+        return NULL;
+    }
+    loxSetOutput(context, output, errors);
+    for(int i = 0; i < ROUNDS; i++){
+        if(loxInterpret(context, test->source, strlen(test->source)) != test->result) test->failures++;
+    }
+    if(!holdsRounds(output, test->output) || !holdsRounds(errors, test->errors)) test->failures++;
+    fclose(output);
+    fclose(errors);
+    loxFreeContext(context);
+    return NULL;
+}
+
+int main(){
+    size_t count = sizeof(cases) / sizeof(cases[0]);
+    pthread_t threads[sizeof(cases) / sizeof(cases[0])];
+    for(size_t i = 0; i < count; i++){
+        if(pthread_create(&threads[i], NULL, runCase, &cases[i]) != 0) return 1;
+    }
+    int failures = 0;
+    for(size_t i = 0; i < count; i++){
+        pthread_join(threads[i], NULL);
+        if(cases[i].failures) fprintf(stderr, "%s: %d failures\n", cases[i].source, cases[i].failures);
+        failures += cases[i].failures;
+    }
+    printf("%d failures across %zu concurrent contexts\n", failures, count);
+    return failures != 0;
+}
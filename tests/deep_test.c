@@ -0,0 +1,93 @@
+// Runs expressions nested a million levels deep through the interpreter
+// given as the first argument: printed as a tree, run on the VM and run
+// on the flat evaluator. Any of them recursing per level would overflow
+// the stack long before the end.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+#define DEPTH 1000000
+
+typedef struct{
+    const char* name;
+    // the source is open DEPTH times, then "1", then close DEPTH times
+    const char* open;
+    const char* close;
+    // how the printer writes one level
+    const char* printedOpen;
+    const char* printedClose;
+} Shape;
+
+static const Shape shapes[] = {
+    {"groups", "(", ")", "(group ", ")"},
+    {"unary", "-", "", "(- ", ")"},
+};
+
+static bool writeSource(const char* path, const Shape* shape){
+    FILE* file = fopen(path, "w");
+    if(!file) return false;
+    for(int i = 0; i < DEPTH; i++) fputs(shape->open, file);
+    fputc('1', file);
+    for(int i = 0; i < DEPTH; i++) fputs(shape->close, file);
+    fputc(';', file);
+    return fclose(file) == 0;
+}
+
+// reads expected from output, text repeated count times
+static bool expect(FILE* output, const char* text, int count){
+    size_t length = strlen(text);
+    for(int i = 0; i < count; i++){
+        for(size_t j = 0; j < length; j++){
+            if(fgetc(output) != text[j]) return false;
+        }
+    }
+    return true;
+}
+
+static bool run(const char* interpreter, const char* options, const char* path, const Shape* shape, bool printed){
+    char command[4096];
+    snprintf(command, sizeof(command), "\"%s\" %s \"%s\"", interpreter, options, path);
+    FILE* output = popen(command, "r");
+    if(!output) return false;
+    bool ok;
+    if(printed){
+        ok = expect(output, "\n--- Expression Result ---\n", 1) &&
+             expect(output, shape->printedOpen, DEPTH) && expect(output, "1", 1) &&
+             expect(output, shape->printedClose, DEPTH) && expect(output, "\n", 1);
+    }
+    else{
+        // an even number of negations leaves the value as it was
+        ok = expect(output, "1\n", 1);
+    }
+    ok = ok && fgetc(output) == EOF;
+    int status = pclose(output);
+    ok = ok && status == 0;
+    if(!ok) fprintf(stderr, "%s %s: unexpected output or exit status\n", shape->name, options);
+    return ok;
+}
+
+int main(int argc, char** argv){
+    if(argc != 2){
+        fprintf(stderr, "Usage: deep_test interpreter\n");
+        return 2;
+    }
+    char path[] = "/tmp/lox_deep_XXXXXX";
+    int fd = mkstemp(path);
+    if(fd < 0) return 2;
+    close(fd);
+    int failures = 0;
+    for(size_t i = 0; i < sizeof(shapes) / sizeof(shapes[0]); i++){
+        if(!writeSource(path, &shapes[i])){
+            failures++;
+            continue;
+        }
+        if(!run(argv[1], "--no-tokens", path, &shapes[i], true)) failures++;
+        if(!run(argv[1], "--vm", path, &shapes[i], false)) failures++;
+        if(!run(argv[1], "--flat", path, &shapes[i], false)) failures++;
+    }
+    remove(path);
+    printf("%d failures at depth %d\n", failures, DEPTH);
+    return failures != 0;
+}
@@ -0,0 +1,80 @@
+// Checks that a cloned flat tree stands on its own: each expression is
+// parsed, flattened and cloned, the original and the pointer tree are
+// released, and only then is the clone evaluated.
+#include "flat/flat.h"
+#include "parser/parser.h"
+#include "memory/arena.h"
+#include "intern/intern.h"
+#include <stdio.h>
+#include <string.h>
+
+typedef struct{
+    const char* source;
+    const char* expected;
+} Case;
+
+static const Case cases[] = {
+    {"1 + 2 * 3", "7"},
+    {"(1 + 2.5) * -2", "-7.000000"},
+    {"\"ab\" + \"cd\" == \"abcd\"", "true"},
+    {"!(3 >= 4) == !nil", "true"},
+    {"140737488355327 + 1", "140737488355328.000000"},
+    {"-\"a\"", NULL},
+};
+
+// flattens source into a clone that shares nothing with what it came from
+static bool cloneFromSource(const char* source, InternTable* strings, FlatTree* copy){
+    Arena arena;
+    Scanner scanner;
+    Parser parser;
+    initArena(&arena);
+    initScannerState(&scanner, source, strlen(source));
+    initParserState(&parser, &scanner, NULL, &arena, strings);
+    Expr* expr = parseExpression(&parser);
+    FlatTree tree;
+    initFlatTree(&tree);
+    bool ok = expr && !parser.hadError && flattenExpr(&tree, expr) && cloneFlatTree(copy, &tree);
+    freeFlatTree(&tree);
+    freeArena(&arena);
+    return ok;
+}
+
+static bool runCase(const Case* test, InternTable* strings){
+    FlatTree copy;
+    if(!cloneFromSource(test->source, strings, &copy)){
+        fprintf(stderr, "%s: failed to parse or clone\n", test->source);
+        return false;
+    }
+    Value result;
+    InterpretResult status = evaluateFlatTree(&copy, strings, &result);
+    bool passed;
+    if(!test->expected){
+        passed = status == INTERPRET_RUNTIME_ERROR;
+    }
+    else{
+        char text[64] = "";
+        if(status == INTERPRET_OK){
+            if(IS_STRING(result)) snprintf(text, sizeof(text), "%s", AS_STRING(result)->chars);
+            else if(IS_BOOL(result)) snprintf(text, sizeof(text), "%s", AS_BOOL(result) ? "true" : "false");
+            else if(IS_INT(result)) snprintf(text, sizeof(text), "%lld", (long long)AS_INT(result));
+            else if(IS_FLOAT(result)) snprintf(text, sizeof(text), "%f", AS_FLOAT(result));
+            else snprintf(text, sizeof(text), "nil");
+        }
+        passed = strcmp(text, test->expected) == 0;
+        if(!passed) fprintf(stderr, "%s: expected %s, got %s\n", test->source, test->expected, text);
+    }
+    freeFlatTree(&copy);
+    return passed;
+}
+
+int main(){
+    InternTable strings;
+    initInternTableState(&strings);
+    int failures = 0;
+    for(size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++){
+        if(!runCase(&cases[i], &strings)) failures++;
+    }
+    freeInternTableState(&strings);
+    printf("%d of %zu flat tree cases failed\n", failures, sizeof(cases) / sizeof(cases[0]));
+    return failures != 0;
+}